@@ -0,0 +1,258 @@
+#include "corpus_generator.h"
+
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct BenchmarkOptions {
+    vector<size_t> document_counts = { 10000, 1000000, 10000000 };
+    size_t query_count = 1000;
+    size_t remove_count = 1000;
+    uint64_t seed = 42;
+    string output_path; // Пусто - вывод в std::cout
+};
+
+struct BenchmarkResult {
+    string name;
+    size_t document_count = 0;
+    size_t operations = 0;
+    double total_ms = 0.0;
+    double ns_per_operation = 0.0;
+    int64_t p50_ns = 0;
+    int64_t p99_ns = 0;
+};
+
+using Clock = chrono::steady_clock;
+
+int64_t GetQuantile(vector<int64_t>& durations, double quantile) {
+    if (durations.empty()) {
+        return 0;
+    }
+    const auto position = durations.begin() + static_cast<ptrdiff_t>(quantile * (durations.size() - 1));
+    nth_element(durations.begin(), position, durations.end());
+    return *position;
+}
+
+// Замеряет каждую операцию отдельно, чтобы кроме среднего получить квантили.
+// Входные данные операции готовит prepare, его время в замер не входит
+template <typename Prepare, typename Operation>
+BenchmarkResult Measure(string name, size_t document_count, size_t operations, Prepare prepare, Operation operation) {
+    vector<int64_t> durations;
+    durations.reserve(operations);
+    for (size_t i = 0; i < operations; ++i) {
+        auto input = prepare(i);
+        const auto start = Clock::now();
+        operation(input);
+        durations.push_back(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count());
+    }
+    BenchmarkResult result{ move(name), document_count, operations };
+    int64_t total_ns = 0;
+    for (const int64_t duration : durations) {
+        total_ns += duration;
+    }
+    result.total_ms = total_ns / 1e6;
+    result.ns_per_operation = operations == 0 ? 0.0 : static_cast<double>(total_ns) / operations;
+    result.p50_ns = GetQuantile(durations, 0.5);
+    result.p99_ns = GetQuantile(durations, 0.99);
+    return result;
+}
+
+template <typename Operation>
+BenchmarkResult Measure(string name, size_t document_count, size_t operations, Operation operation) {
+    return Measure(move(name), document_count, operations, [](size_t i) { return i; }, operation);
+}
+
+// Пакетная операция замеряется целиком, время делится на число обработанных элементов
+template <typename Operation>
+BenchmarkResult MeasureBatch(string name, size_t document_count, size_t items, Operation operation) {
+    const auto start = Clock::now();
+    operation();
+    const int64_t total_ns = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+    BenchmarkResult result{ move(name), document_count, items };
+    result.total_ms = total_ns / 1e6;
+    result.ns_per_operation = items == 0 ? 0.0 : static_cast<double>(total_ns) / items;
+    return result;
+}
+
+void RunBenchmarks(const BenchmarkOptions& options, size_t document_count, vector<BenchmarkResult>& results) {
+    CorpusOptions corpus_options;
+    corpus_options.seed = options.seed;
+    const CorpusGenerator generator(corpus_options);
+    QueryOptions query_options;
+    query_options.seed = options.seed + 1;
+    const vector<string> queries = generator.GenerateQueries(options.query_count, query_options);
+
+    SearchServer search_server(generator.GetStopWords());
+    results.push_back(Measure("AddDocument"s, document_count, document_count, [&generator](size_t i) {
+        return generator.GenerateDocument(static_cast<int>(i));
+        }, [&search_server](const GeneratedDocument& document) {
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }));
+    cerr << "Indexed "s << document_count << " documents"s << endl;
+
+    const auto odd_rating = [](int, DocumentStatus, int rating) {
+        return rating % 2 != 0;
+    };
+    const size_t query_count = queries.size();
+    results.push_back(Measure("FindTopDocuments/seq"s, document_count, query_count, [&](size_t i) {
+        search_server.FindTopDocuments(execution::seq, queries[i]);
+        }));
+    results.push_back(Measure("FindTopDocuments/par"s, document_count, query_count, [&](size_t i) {
+        search_server.FindTopDocuments(execution::par, queries[i]);
+        }));
+    for (const auto& [status, status_name] : { pair{ DocumentStatus::ACTUAL, "ACTUAL"sv }, pair{ DocumentStatus::IRRELEVANT, "IRRELEVANT"sv },
+                                               pair{ DocumentStatus::BANNED, "BANNED"sv }, pair{ DocumentStatus::REMOVED, "REMOVED"sv } }) {
+        const string suffix = "/status="s + string(status_name);
+        results.push_back(Measure("FindTopDocuments/seq"s + suffix, document_count, query_count, [&, status = status](size_t i) {
+            search_server.FindTopDocuments(execution::seq, queries[i], status);
+            }));
+        results.push_back(Measure("FindTopDocuments/par"s + suffix, document_count, query_count, [&, status = status](size_t i) {
+            search_server.FindTopDocuments(execution::par, queries[i], status);
+            }));
+    }
+    results.push_back(Measure("FindTopDocuments/seq/predicate"s, document_count, query_count, [&](size_t i) {
+        search_server.FindTopDocuments(execution::seq, queries[i], odd_rating);
+        }));
+    results.push_back(Measure("FindTopDocuments/par/predicate"s, document_count, query_count, [&](size_t i) {
+        search_server.FindTopDocuments(execution::par, queries[i], odd_rating);
+        }));
+
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    const auto pick_document = [&document_ids](size_t i) {
+        return document_ids[(i * 7919) % document_ids.size()];
+    };
+    results.push_back(Measure("MatchDocument/seq"s, document_count, query_count, [&](size_t i) {
+        search_server.MatchDocument(execution::seq, queries[i], pick_document(i));
+        }));
+    results.push_back(Measure("MatchDocument/par"s, document_count, query_count, [&](size_t i) {
+        search_server.MatchDocument(execution::par, queries[i], pick_document(i));
+        }));
+
+    results.push_back(MeasureBatch("ProcessQueries"s, document_count, query_count, [&] {
+        ProcessQueries(search_server, queries);
+        }));
+
+    // Удаляются разные документы: сначала последовательной версией, затем параллельной
+    const size_t remove_count = min(options.remove_count, document_ids.size() / 2);
+    results.push_back(Measure("RemoveDocument/seq"s, document_count, remove_count, [&](size_t i) {
+        search_server.RemoveDocument(execution::seq, document_ids[i * 2]);
+        }));
+    results.push_back(Measure("RemoveDocument/par"s, document_count, remove_count, [&](size_t i) {
+        search_server.RemoveDocument(execution::par, document_ids[i * 2 + 1]);
+        }));
+
+    // RemoveDuplicates сообщает о каждом дубликате в std::cout, на время замера вывод отключается
+    const size_t remaining_count = static_cast<size_t>(search_server.GetDocumentCount());
+    ostringstream discarded_output;
+    auto* const cout_buffer = cout.rdbuf(discarded_output.rdbuf());
+    results.push_back(MeasureBatch("RemoveDuplicates"s, document_count, remaining_count, [&] {
+        RemoveDuplicates(search_server);
+        }));
+    cout.rdbuf(cout_buffer);
+}
+
+void PrintJsonString(ostream& output, string_view text) {
+    output << '"';
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            output << '\\';
+        }
+        output << c;
+    }
+    output << '"';
+}
+
+void PrintJson(ostream& output, const BenchmarkOptions& options, const vector<BenchmarkResult>& results) {
+    output << "{\n  \"seed\": "s << options.seed << ",\n  \"query_count\": "s << options.query_count << ",\n  \"benchmarks\": [\n"s;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        output << "    { \"name\": "s;
+        PrintJsonString(output, result.name);
+        output << ", \"documents\": "s << result.document_count
+            << ", \"operations\": "s << result.operations
+            << ", \"total_ms\": "s << result.total_ms
+            << ", \"ns_per_op\": "s << result.ns_per_operation
+            << ", \"p50_ns\": "s << result.p50_ns
+            << ", \"p99_ns\": "s << result.p99_ns << " }"s
+            << (i + 1 < results.size() ? ",\n"s : "\n"s);
+    }
+    output << "  ]\n}\n"s;
+}
+
+vector<size_t> ParseSizes(string_view text) {
+    vector<size_t> sizes;
+    while (!text.empty()) {
+        const size_t comma = text.find(',');
+        sizes.push_back(stoull(string(text.substr(0, comma))));
+        text.remove_prefix(comma == text.npos ? text.size() : comma + 1);
+    }
+    return sizes;
+}
+
+BenchmarkOptions ParseOptions(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view argument = argv[i];
+        const size_t equals = argument.find('=');
+        const string_view key = argument.substr(0, equals);
+        const string value = equals == argument.npos ? ""s : string(argument.substr(equals + 1));
+        if (key == "--sizes"sv) {
+            options.document_counts = ParseSizes(value);
+        }
+        else if (key == "--queries"sv) {
+            options.query_count = stoull(value);
+        }
+        else if (key == "--removes"sv) {
+            options.remove_count = stoull(value);
+        }
+        else if (key == "--seed"sv) {
+            options.seed = stoull(value);
+        }
+        else if (key == "--output"sv) {
+            options.output_path = value;
+        }
+        else {
+            throw invalid_argument("unknown option "s + string(argument));
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const BenchmarkOptions options = ParseOptions(argc, argv);
+        vector<BenchmarkResult> results;
+        for (const size_t document_count : options.document_counts) {
+            RunBenchmarks(options, document_count, results);
+        }
+        if (options.output_path.empty()) {
+            PrintJson(cout, options, results);
+        }
+        else {
+            ofstream output(options.output_path);
+            PrintJson(output, options, results);
+        }
+    }
+    catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        cerr << "Usage: search_server_benchmark [--sizes=10000,1000000,10000000] [--queries=1000] [--removes=1000] [--seed=42] [--output=results.json]"s << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+CorpusGenerator::Random::Random(uint64_t seed)
+    : state_(seed) {
+}
+
+uint64_t CorpusGenerator::Random::Next() {
+    uint64_t value = (state_ += 0x9E3779B97F4A7C15ull);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+double CorpusGenerator::Random::NextDouble() {
+    return static_cast<double>(Next() >> 11) * 0x1.0p-53;
+}
+
+size_t CorpusGenerator::Random::NextInRange(size_t first, size_t last) {
+    return first + static_cast<size_t>(Next() % (last - first + 1));
+}
+
+CorpusGenerator::CorpusGenerator(CorpusOptions options)
+    : options_(options) {
+    if (options_.vocabulary_size == 0 || options_.min_document_length == 0 || options_.min_document_length > options_.max_document_length) {
+        throw std::invalid_argument("invalid corpus options");
+    }
+    // Стоп-слова и словарь не пересекаются: стоп-слова берутся из начала общей последовательности слов
+    for (size_t i = 0; i < options_.stop_word_count; ++i) {
+        stop_words_.push_back(MakeWord(i));
+    }
+    vocabulary_.reserve(options_.vocabulary_size);
+    zipf_cdf_.reserve(options_.vocabulary_size);
+    double total = 0.0;
+    for (size_t rank = 0; rank < options_.vocabulary_size; ++rank) {
+        vocabulary_.push_back(MakeWord(options_.stop_word_count + rank));
+        total += 1.0 / std::pow(static_cast<double>(rank + 1), options_.zipf_exponent);
+        zipf_cdf_.push_back(total);
+    }
+    for (double& value : zipf_cdf_) {
+        value /= total;
+    }
+}
+
+std::string CorpusGenerator::GetStopWords() const {
+    std::string result;
+    for (const std::string& word : stop_words_) {
+        if (!result.empty()) {
+            result += ' ';
+        }
+        result += word;
+    }
+    return result;
+}
+
+// Номер слова записывается в системе счисления по основанию 26 буквами латинского алфавита
+std::string CorpusGenerator::MakeWord(size_t index) {
+    std::string word;
+    do {
+        word += static_cast<char>('a' + index % 26);
+        index /= 26;
+    } while (index > 0);
+    return word;
+}
+
+const std::string& CorpusGenerator::SampleWord(Random& random) const {
+    const double value = random.NextDouble();
+    const size_t rank = std::upper_bound(zipf_cdf_.begin(), zipf_cdf_.end(), value) - zipf_cdf_.begin();
+    return vocabulary_[std::min(rank, vocabulary_.size() - 1)];
+}
+
+void CorpusGenerator::AppendDocumentWords(int document_id, std::string& text) const {
+    Random random(options_.seed ^ (static_cast<uint64_t>(document_id) * 0xD6E8FEB86659FD93ull));
+    const size_t length = random.NextInRange(options_.min_document_length, options_.max_document_length);
+    for (size_t i = 0; i < length; ++i) {
+        if (!text.empty()) {
+            text += ' ';
+        }
+        if (!stop_words_.empty() && random.NextDouble() < options_.stop_word_ratio) {
+            text += stop_words_[random.NextInRange(0, stop_words_.size() - 1)];
+        }
+        else {
+            text += SampleWord(random);
+        }
+    }
+}
+
+GeneratedDocument CorpusGenerator::GenerateDocument(int document_id) const {
+    Random random(options_.seed + static_cast<uint64_t>(document_id));
+    GeneratedDocument document;
+    document.id = document_id;
+
+    // Дубликат повторяет слова одного из предыдущих документов, их порядок и частоты не важны
+    int source_id = document_id;
+    if (document_id > 0 && random.NextDouble() < options_.duplicate_ratio) {
+        source_id = static_cast<int>(random.NextInRange(0, static_cast<size_t>(document_id) - 1));
+    }
+    AppendDocumentWords(source_id, document.text);
+
+    const double status_value = random.NextDouble();
+    document.status = status_value < 0.8 ? DocumentStatus::ACTUAL
+        : status_value < 0.9 ? DocumentStatus::IRRELEVANT
+        : status_value < 0.95 ? DocumentStatus::BANNED
+        : DocumentStatus::REMOVED;
+    const size_t rating_count = random.NextInRange(1, 5);
+    for (size_t i = 0; i < rating_count; ++i) {
+        document.ratings.push_back(static_cast<int>(random.NextInRange(0, 10)) - 2);
+    }
+    return document;
+}
+
+std::vector<std::string> CorpusGenerator::GenerateQueries(size_t query_count, const QueryOptions& options) const {
+    Random random(options.seed);
+    std::vector<std::string> queries;
+    queries.reserve(query_count);
+    for (size_t i = 0; i < query_count; ++i) {
+        std::string query;
+        const size_t length = random.NextInRange(options.min_query_length, options.max_query_length);
+        for (size_t j = 0; j < length; ++j) {
+            if (!query.empty()) {
+                query += ' ';
+            }
+            // Первое слово всегда плюс-слово, иначе запрос заведомо пуст
+            if (j > 0 && random.NextDouble() < options.minus_word_probability) {
+                query += '-';
+            }
+            query += SampleWord(random);
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
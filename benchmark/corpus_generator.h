@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "document.h"
+
+// Параметры синтетического корпуса. Один и тот же seed даёт один и тот же корпус на любой платформе
+struct CorpusOptions {
+    size_t vocabulary_size = 100000;
+    double zipf_exponent = 1.0;      // Частота слова ранга r пропорциональна 1 / r^zipf_exponent
+    size_t min_document_length = 8;
+    size_t max_document_length = 32;
+    size_t stop_word_count = 16;
+    double stop_word_ratio = 0.2;    // Доля стоп-слов среди слов документа
+    double duplicate_ratio = 0.01;   // Доля документов, повторяющих набор слов одного из предыдущих
+    uint64_t seed = 42;
+};
+
+// Параметры потока запросов к корпусу
+struct QueryOptions {
+    size_t min_query_length = 1;
+    size_t max_query_length = 4;
+    double minus_word_probability = 0.1; // Вероятность того, что слово запроса - минус-слово
+    uint64_t seed = 4242;
+};
+
+struct GeneratedDocument {
+    int id;
+    std::string text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+// Детерминированный генератор документов и запросов со словарём, распределённым по закону Ципфа.
+// Документы порождаются по номеру, поэтому корпус любого размера не требует хранения в памяти целиком
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(CorpusOptions options);
+
+    // Стоп-слова через пробел для конструктора SearchServer
+    std::string GetStopWords() const;
+
+    GeneratedDocument GenerateDocument(int document_id) const;
+
+    std::vector<std::string> GenerateQueries(size_t query_count, const QueryOptions& options) const;
+
+private:
+    // Генератор splitmix64: результат определяется только состоянием, в отличие от распределений стандартной библиотеки
+    class Random {
+    public:
+        explicit Random(uint64_t seed);
+
+        uint64_t Next();
+
+        // Равномерно в [0, 1)
+        double NextDouble();
+
+        // Равномерно в [first, last]
+        size_t NextInRange(size_t first, size_t last);
+
+    private:
+        uint64_t state_;
+    };
+
+    CorpusOptions options_;
+    std::vector<std::string> vocabulary_;  // Слова в порядке убывания частоты
+    std::vector<std::string> stop_words_;
+    std::vector<double> zipf_cdf_;
+
+    static std::string MakeWord(size_t index);
+
+    const std::string& SampleWord(Random& random) const;
+
+    void AppendDocumentWords(int document_id, std::string& text) const;
+};
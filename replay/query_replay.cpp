@@ -0,0 +1,487 @@
+#include "metrics.h"
+#include "read_input_functions.h"
+#include "search_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <execution>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+enum class LoadMode {
+    CLOSED, // Каждый клиент отправляет следующий запрос сразу после ответа на предыдущий
+    OPEN,   // Запросы поступают с заданной частотой или по меткам времени журнала независимо от ответов
+};
+
+struct ReplayOptions {
+    string corpus_path;
+    string queries_path;
+    string stop_words;
+    LoadMode mode = LoadMode::CLOSED;
+    size_t thread_count = max(thread::hardware_concurrency(), 1u);
+    size_t request_count = 0;        // 0 - один проход по журналу
+    size_t warmup_count = 0;
+    double rate = 0.0;               // Открытая модель: запросов в секунду, 0 - по меткам времени журнала
+    double speed = 1.0;              // Ускорение воспроизведения по меткам времени
+    chrono::nanoseconds expected_interval{ 0 }; // Закрытая модель: ожидаемый интервал между запросами клиента
+    bool parallel = false;           // FindTopDocuments с std::execution::par
+    string connect_address;          // host:port сервера запросов, пусто - поиск в процессе
+};
+
+struct LoggedQuery {
+    string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    optional<chrono::nanoseconds> timestamp; // Смещение от первого запроса журнала
+};
+
+// Гистограмма потока на основе корзин LatencyHistogram
+class LatencyRecorder {
+public:
+    void Record(chrono::nanoseconds latency) {
+        const uint64_t value = static_cast<uint64_t>(max<int64_t>(latency.count(), 0));
+        ++histogram_.buckets[LatencyHistogram::GetBucketIndex(value)];
+        ++histogram_.count;
+        histogram_.total_ns += value;
+        max_ns_ = max(max_ns_, value);
+    }
+
+    // Коррекция скоординированного пропуска для закрытой модели: если ответ задержался дольше ожидаемого
+    // интервала, запросы, которые клиент не успел отправить, учитываются с убывающими задержками
+    void RecordCorrected(chrono::nanoseconds latency, chrono::nanoseconds expected_interval) {
+        Record(latency);
+        if (expected_interval.count() <= 0) {
+            return;
+        }
+        for (auto missed = latency - expected_interval; missed >= expected_interval; missed -= expected_interval) {
+            Record(missed);
+        }
+    }
+
+    void Merge(const LatencyRecorder& other) {
+        for (size_t i = 0; i < histogram_.buckets.size(); ++i) {
+            histogram_.buckets[i] += other.histogram_.buckets[i];
+        }
+        histogram_.count += other.histogram_.count;
+        histogram_.total_ns += other.histogram_.total_ns;
+        max_ns_ = max(max_ns_, other.max_ns_);
+    }
+
+    const StageMetrics& GetHistogram() const {
+        return histogram_;
+    }
+
+    uint64_t GetMaxNs() const {
+        return max_ns_;
+    }
+
+private:
+    StageMetrics histogram_;
+    uint64_t max_ns_ = 0;
+};
+
+vector<string_view> SplitByTab(string_view line) {
+    vector<string_view> fields;
+    while (true) {
+        const size_t tab = line.find('\t');
+        fields.push_back(line.substr(0, tab));
+        if (tab == line.npos) {
+            return fields;
+        }
+        line.remove_prefix(tab + 1);
+    }
+}
+
+bool IsNumber(string_view text) {
+    return !text.empty() && all_of(text.begin(), text.end(), [](char c) {
+        return c >= '0' && c <= '9';
+        });
+}
+
+// Строка журнала: "[метка времени в мс<TAB>][STATUS<TAB>]запрос"
+vector<LoggedQuery> LoadQueries(const string& path) {
+    ifstream input(path);
+    if (!input) {
+        throw runtime_error("cannot open query log "s + path);
+    }
+    vector<LoggedQuery> queries;
+    optional<chrono::nanoseconds> first_timestamp;
+    string line;
+    while (getline(input, line)) {
+        auto fields = SplitByTab(line);
+        LoggedQuery query;
+        query.text = string(fields.back());
+        fields.pop_back();
+        if (!fields.empty() && IsNumber(fields.front())) {
+            const chrono::nanoseconds timestamp = chrono::milliseconds(stoll(string(fields.front())));
+            if (!first_timestamp) {
+                first_timestamp = timestamp;
+            }
+            query.timestamp = timestamp - *first_timestamp;
+            fields.erase(fields.begin());
+        }
+        if (!fields.empty()) {
+            query.status = ParseDocumentStatus(fields.front());
+        }
+        queries.push_back(move(query));
+    }
+    if (queries.empty()) {
+        throw invalid_argument("query log is empty");
+    }
+    return queries;
+}
+
+string_view GetStatusName(DocumentStatus status) {
+    switch (status) {
+    case DocumentStatus::ACTUAL:
+        return "ACTUAL"sv;
+    case DocumentStatus::IRRELEVANT:
+        return "IRRELEVANT"sv;
+    case DocumentStatus::BANNED:
+        return "BANNED"sv;
+    case DocumentStatus::REMOVED:
+        return "REMOVED"sv;
+    }
+    return "ACTUAL"sv;
+}
+
+// Блокирующее соединение клиента с сервером запросов: запрос - строка, ответ - "OK n" и n строк либо "ERR ..."
+class RemoteConnection {
+public:
+    explicit RemoteConnection(const string& host_and_port) {
+        const size_t colon = host_and_port.rfind(':');
+        if (colon == string::npos) {
+            throw invalid_argument("--connect must be host:port");
+        }
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(stoul(host_and_port.substr(colon + 1))));
+        if (inet_pton(AF_INET, host_and_port.substr(0, colon).c_str(), &address.sin_addr) != 1) {
+            throw invalid_argument("invalid address "s + host_and_port);
+        }
+        fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd_ < 0 || connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+            if (fd_ >= 0) {
+                close(fd_);
+            }
+            throw runtime_error("cannot connect to "s + host_and_port);
+        }
+        const int enable = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+
+    RemoteConnection(const RemoteConnection&) = delete;
+    RemoteConnection& operator=(const RemoteConnection&) = delete;
+
+    ~RemoteConnection() {
+        close(fd_);
+    }
+
+    // Возвращает false, если сервер ответил ошибкой
+    bool Execute(const LoggedQuery& query) {
+        string request = query.text;
+        request += '\t';
+        request += GetStatusName(query.status);
+        request += '\n';
+        for (size_t sent = 0; sent < request.size();) {
+            const ssize_t size = send(fd_, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (size <= 0) {
+                throw runtime_error("connection to query server lost");
+            }
+            sent += static_cast<size_t>(size);
+        }
+        const string status_line = ReadResponseLine();
+        if (status_line.compare(0, 3, "OK "s) != 0) {
+            return false;
+        }
+        for (size_t lines = stoull(status_line.substr(3)); lines > 0; --lines) {
+            ReadResponseLine();
+        }
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    string buffer_;
+    size_t buffer_offset_ = 0;
+
+    string ReadResponseLine() {
+        while (true) {
+            const size_t line_end = buffer_.find('\n', buffer_offset_);
+            if (line_end != string::npos) {
+                string line = buffer_.substr(buffer_offset_, line_end - buffer_offset_);
+                buffer_offset_ = line_end + 1;
+                return line;
+            }
+            buffer_.erase(0, buffer_offset_);
+            buffer_offset_ = 0;
+            char chunk[16 * 1024];
+            const ssize_t size = recv(fd_, chunk, sizeof(chunk), 0);
+            if (size <= 0) {
+                throw runtime_error("connection to query server lost");
+            }
+            buffer_.append(chunk, static_cast<size_t>(size));
+        }
+    }
+};
+
+struct ReplayResult {
+    size_t request_count = 0;
+    size_t error_count = 0;
+    chrono::nanoseconds elapsed{ 0 };
+    LatencyRecorder latency;      // С учётом ожидания в очереди и коррекции
+    LatencyRecorder service_time; // Только выполнение запроса
+};
+
+class QueryReplayer {
+public:
+    QueryReplayer(const SearchServer& search_server, const vector<LoggedQuery>& queries, const ReplayOptions& options)
+        : search_server_(search_server)
+        , queries_(queries)
+        , options_(options) {
+    }
+
+    ReplayResult Run(size_t request_count) {
+        using Clock = chrono::steady_clock;
+        next_request_.store(0);
+        const size_t thread_count = max<size_t>(options_.thread_count, 1);
+        vector<ReplayResult> thread_results(thread_count);
+        const auto start = Clock::now() + 10ms; // Запас на запуск потоков, чтобы первые запросы не опаздывали
+        vector<exception_ptr> thread_errors(thread_count);
+        {
+            vector<thread> threads;
+            threads.reserve(thread_count);
+            for (size_t i = 0; i < thread_count; ++i) {
+                threads.emplace_back([this, &thread_results, &thread_errors, i, start, request_count] {
+                    // Обрыв соединения с сервером запросов не должен завершать процесс из чужого потока
+                    try {
+                        RunClient(thread_results[i], start, request_count);
+                    }
+                    catch (...) {
+                        thread_errors[i] = current_exception();
+                    }
+                    });
+            }
+            for (thread& client : threads) {
+                client.join();
+            }
+        }
+        for (const exception_ptr& error : thread_errors) {
+            if (error) {
+                rethrow_exception(error);
+            }
+        }
+
+        ReplayResult result;
+        result.elapsed = Clock::now() - start;
+        for (const ReplayResult& thread_result : thread_results) {
+            result.request_count += thread_result.request_count;
+            result.error_count += thread_result.error_count;
+            result.latency.Merge(thread_result.latency);
+            result.service_time.Merge(thread_result.service_time);
+        }
+        return result;
+    }
+
+private:
+    const SearchServer& search_server_;
+    const vector<LoggedQuery>& queries_;
+    const ReplayOptions& options_;
+    atomic<size_t> next_request_{ 0 };
+
+    // Время, когда запрос должен быть отправлен в открытой модели
+    chrono::nanoseconds GetIntendedOffset(size_t request) const {
+        if (options_.rate > 0.0) {
+            return chrono::nanoseconds(static_cast<int64_t>(request * 1e9 / options_.rate));
+        }
+        // По меткам журнала: при повторных проходах сдвиг на длительность журнала
+        const size_t pass = request / queries_.size();
+        const auto log_duration = queries_.back().timestamp.value_or(0ns) + 1ms;
+        const auto offset = queries_[request % queries_.size()].timestamp.value_or(0ns) + log_duration * pass;
+        return chrono::nanoseconds(static_cast<int64_t>(offset.count() / options_.speed));
+    }
+
+    void RunClient(ReplayResult& result, chrono::steady_clock::time_point start, size_t request_count) {
+        using Clock = chrono::steady_clock;
+        optional<RemoteConnection> remote;
+        if (!options_.connect_address.empty()) {
+            remote.emplace(options_.connect_address);
+        }
+        this_thread::sleep_until(start);
+        for (size_t request = next_request_++; request < request_count; request = next_request_++) {
+            Clock::time_point intended_start = Clock::now();
+            if (options_.mode == LoadMode::OPEN) {
+                intended_start = start + GetIntendedOffset(request);
+                this_thread::sleep_until(intended_start);
+            }
+            const LoggedQuery& query = queries_[request % queries_.size()];
+            const auto service_start = Clock::now();
+            try {
+                if (remote) {
+                    if (!remote->Execute(query)) {
+                        ++result.error_count;
+                    }
+                }
+                else if (options_.parallel) {
+                    search_server_.FindTopDocuments(execution::par, query.text, query.status);
+                }
+                else {
+                    search_server_.FindTopDocuments(execution::seq, query.text, query.status);
+                }
+            }
+            catch (const invalid_argument&) {
+                ++result.error_count;
+            }
+            const auto finish = Clock::now();
+            ++result.request_count;
+            result.service_time.Record(finish - service_start);
+            if (options_.mode == LoadMode::OPEN) {
+                // Задержка отсчитывается от запланированного времени, а не от фактической отправки
+                result.latency.Record(finish - intended_start);
+            }
+            else {
+                result.latency.RecordCorrected(finish - service_start, options_.expected_interval);
+            }
+        }
+    }
+};
+
+void PrintLatency(ostream& output, string_view name, const LatencyRecorder& recorder) {
+    const auto to_microseconds = [](chrono::nanoseconds duration) {
+        return chrono::duration<double, micro>(duration).count();
+    };
+    const StageMetrics& histogram = recorder.GetHistogram();
+    output << "  \""sv << name << "\": { \"count\": "sv << histogram.count;
+    for (const auto& [quantile_name, quantile] : { pair{ "p50"sv, 0.5 }, pair{ "p90"sv, 0.9 }, pair{ "p99"sv, 0.99 }, pair{ "p999"sv, 0.999 } }) {
+        output << ", \""sv << quantile_name << "_us\": "sv << to_microseconds(histogram.GetQuantile(quantile));
+    }
+    output << ", \"max_us\": "sv << to_microseconds(chrono::nanoseconds(recorder.GetMaxNs())) << " }"sv;
+}
+
+void PrintResult(ostream& output, const ReplayOptions& options, const ReplayResult& result) {
+    const double seconds = chrono::duration<double>(result.elapsed).count();
+    output << "{\n"sv
+        << "  \"mode\": \""sv << (options.mode == LoadMode::OPEN ? "open"sv : "closed"sv) << "\",\n"sv
+        << "  \"threads\": "sv << options.thread_count << ",\n"sv
+        << "  \"requests\": "sv << result.request_count << ",\n"sv
+        << "  \"errors\": "sv << result.error_count << ",\n"sv
+        << "  \"elapsed_s\": "sv << seconds << ",\n"sv
+        << "  \"qps\": "sv << (seconds > 0.0 ? result.request_count / seconds : 0.0) << ",\n"sv;
+    PrintLatency(output, "latency"sv, result.latency);
+    output << ",\n"sv;
+    PrintLatency(output, "service_time"sv, result.service_time);
+    output << "\n}\n"sv;
+}
+
+ReplayOptions ParseOptions(int argc, char* argv[]) {
+    ReplayOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view argument = argv[i];
+        const size_t equals = argument.find('=');
+        const string_view key = argument.substr(0, equals);
+        const string value = equals == argument.npos ? ""s : string(argument.substr(equals + 1));
+        if (key == "--corpus"sv) {
+            options.corpus_path = value;
+        }
+        else if (key == "--queries"sv) {
+            options.queries_path = value;
+        }
+        else if (key == "--stop-words"sv) {
+            options.stop_words = value;
+        }
+        else if (key == "--mode"sv) {
+            if (value != "open"s && value != "closed"s) {
+                throw invalid_argument("mode must be open or closed");
+            }
+            options.mode = value == "open"s ? LoadMode::OPEN : LoadMode::CLOSED;
+        }
+        else if (key == "--threads"sv) {
+            options.thread_count = stoull(value);
+        }
+        else if (key == "--requests"sv) {
+            options.request_count = stoull(value);
+        }
+        else if (key == "--warmup"sv) {
+            options.warmup_count = stoull(value);
+        }
+        else if (key == "--rate"sv) {
+            options.rate = stod(value);
+        }
+        else if (key == "--speed"sv) {
+            options.speed = stod(value);
+        }
+        else if (key == "--expected-interval-us"sv) {
+            options.expected_interval = chrono::microseconds(stoll(value));
+        }
+        else if (key == "--par"sv) {
+            options.parallel = true;
+        }
+        else if (key == "--connect"sv) {
+            options.connect_address = value;
+        }
+        else {
+            throw invalid_argument("unknown option "s + string(argument));
+        }
+    }
+    if (options.queries_path.empty() || (options.corpus_path.empty() && options.connect_address.empty())) {
+        throw invalid_argument("--queries and either --corpus or --connect are required");
+    }
+    if (options.speed <= 0.0) {
+        throw invalid_argument("speed must be positive");
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        ReplayOptions options = ParseOptions(argc, argv);
+        SearchServer search_server(options.stop_words);
+        // С --connect запросы выполняет сервер запросов, локальный индекс остаётся пустым
+        if (options.connect_address.empty()) {
+            ifstream corpus(options.corpus_path);
+            if (!corpus) {
+                throw runtime_error("cannot open corpus "s + options.corpus_path);
+            }
+            ReadDocuments(corpus, search_server);
+        }
+        const vector<LoggedQuery> queries = LoadQueries(options.queries_path);
+        if (options.request_count == 0) {
+            options.request_count = queries.size();
+        }
+        cerr << "Loaded "s << search_server.GetDocumentCount() << " documents and "s << queries.size() << " queries"s << endl;
+
+        QueryReplayer replayer(search_server, queries, options);
+        if (options.warmup_count > 0) {
+            ReplayOptions warmup_options = options;
+            warmup_options.mode = LoadMode::CLOSED;
+            QueryReplayer(search_server, queries, warmup_options).Run(options.warmup_count);
+        }
+        PrintResult(cout, options, replayer.Run(options.request_count));
+    }
+    catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        cerr << "Usage: query_replay (--corpus=corpus.tsv | --connect=127.0.0.1:7700) --queries=queries.log [--stop-words=\"and in on\"] [--mode=closed|open]"s
+            << " [--threads=N] [--requests=N] [--warmup=N] [--rate=QPS] [--speed=1.0] [--expected-interval-us=N] [--par]"s << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include "async_search.h"
+
+namespace {
+
+// Вес нового замера в скользящем среднем времени обработки: 1 / 2^SERVICE_TIME_SMOOTHING_SHIFT
+const int SERVICE_TIME_SMOOTHING_SHIFT = 3;
+
+}
+
+AsyncSearchExecutor::AsyncSearchExecutor(const SearchServer& search_server, AdmissionOptions options)
+    : search_server_(search_server)
+    , options_(options) {
+    if (options_.worker_count == 0 || options_.max_queue_depth == 0) {
+        throw std::invalid_argument("invalid admission options");
+    }
+    workers_.reserve(options_.worker_count);
+    for (size_t i = 0; i < options_.worker_count; ++i) {
+        workers_.emplace_back([this] { RunWorker(); });
+    }
+}
+
+AsyncSearchExecutor::~AsyncSearchExecutor() {
+    {
+        std::lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    tasks_cv_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+std::future<std::vector<Document>> AsyncSearchExecutor::Submit(AsyncQuery query) {
+    auto promise = std::make_shared<std::promise<std::vector<Document>>>();
+    std::future<std::vector<Document>> result = promise->get_future();
+    const bool accepted = TrySubmit(std::move(query), [promise](std::vector<Document> documents, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        }
+        else {
+            promise->set_value(std::move(documents));
+        }
+        });
+    if (!accepted) {
+        promise->set_exception(std::make_exception_ptr(QueryRejectedError("query rejected: search server is overloaded")));
+    }
+    return result;
+}
+
+bool AsyncSearchExecutor::TrySubmit(AsyncQuery query, QueryCallback callback) {
+    {
+        std::lock_guard guard(mutex_);
+        const bool overloaded = queue_depth_ >= options_.max_queue_depth
+            || (options_.max_estimated_wait.count() > 0 && EstimateWait(query.priority) > options_.max_estimated_wait);
+        if (stopping_ || overloaded) {
+            ++rejected_;
+            return false;
+        }
+        lanes_[static_cast<size_t>(query.priority)].push_back({ std::move(query), std::move(callback) });
+        ++queue_depth_;
+    }
+    ++accepted_;
+    tasks_cv_.notify_one();
+    return true;
+}
+
+size_t AsyncSearchExecutor::GetQueueDepth() const {
+    std::lock_guard guard(mutex_);
+    return queue_depth_;
+}
+
+std::chrono::nanoseconds AsyncSearchExecutor::GetEstimatedWait(QueryPriority priority) const {
+    std::lock_guard guard(mutex_);
+    return EstimateWait(priority);
+}
+
+AdmissionStats AsyncSearchExecutor::GetStats() const {
+    return { accepted_.load(), rejected_.load(), completed_.load() };
+}
+
+std::chrono::nanoseconds AsyncSearchExecutor::EstimateWait(QueryPriority priority) const {
+    size_t queued_ahead = 0;
+    for (size_t lane = 0; lane <= static_cast<size_t>(priority); ++lane) {
+        queued_ahead += lanes_[lane].size();
+    }
+    const int64_t wait_ns = static_cast<int64_t>(queued_ahead) * average_service_ns_.load(std::memory_order_relaxed)
+        / static_cast<int64_t>(options_.worker_count);
+    return std::chrono::nanoseconds(wait_ns);
+}
+
+void AsyncSearchExecutor::RunWorker() {
+    while (true) {
+        Task task;
+        bool cancelled;
+        {
+            std::unique_lock lock(mutex_);
+            tasks_cv_.wait(lock, [this] { return stopping_ || queue_depth_ > 0; });
+            if (queue_depth_ == 0) {
+                return;
+            }
+            auto lane = std::find_if(lanes_.begin(), lanes_.end(), [](const std::deque<Task>& tasks) { return !tasks.empty(); });
+            task = std::move(lane->front());
+            lane->pop_front();
+            --queue_depth_;
+            cancelled = stopping_;
+        }
+        // При остановке очередь разбирают те же обработчики, чтобы callback вызывался в их потоках
+        if (cancelled) {
+            task.callback({}, std::make_exception_ptr(QueryRejectedError("query executor is stopped")));
+        }
+        else {
+            Execute(task);
+        }
+    }
+}
+
+void AsyncSearchExecutor::Execute(Task& task) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<Document> documents;
+    std::exception_ptr error;
+    const auto start = Clock::now();
+    try {
+        // Та же выдача, что и у синхронного FindTopDocuments, включая списки чемпионов
+        documents = search_server_.FindTopDocuments(task.query.raw_query, task.query.filter);
+        if (documents.size() > task.query.max_results) {
+            documents.resize(task.query.max_results);
+        }
+    }
+    catch (...) {
+        error = std::current_exception();
+    }
+    const int64_t service_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+    // Гонка обновлений между обработчиками лишь теряет отдельные замеры, что для оценки допустимо
+    const int64_t average_ns = average_service_ns_.load(std::memory_order_relaxed);
+    average_service_ns_.store(average_ns == 0 ? service_ns : average_ns + ((service_ns - average_ns) >> SERVICE_TIME_SMOOTHING_SHIFT),
+        std::memory_order_relaxed);
+
+    task.callback(std::move(documents), error);
+    ++completed_;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+
+// Полосы очереди: запрос обслуживается, только когда в полосах выше не осталось запросов
+enum class QueryPriority {
+    HIGH,
+    NORMAL,
+    LOW,
+};
+
+const size_t QUERY_PRIORITY_COUNT = 3;
+
+struct AsyncQuery {
+    std::string raw_query;
+    DocumentFilter filter = DocumentFilter(DocumentStatus::ACTUAL);
+    size_t max_results = MAX_RESULT_DOCUMENT_COUNT; // Выдача FindTopDocuments усекается до max_results документов
+    QueryPriority priority = QueryPriority::NORMAL;
+};
+
+// Параметры допуска запросов в очередь
+struct AdmissionOptions {
+    size_t worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+    size_t max_queue_depth = 1024;                        // Запросов во всех полосах, ожидающих обработчика
+    std::chrono::nanoseconds max_estimated_wait{ 100ms }; // 0 - ожидание не оценивается
+};
+
+struct AdmissionStats {
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+    uint64_t completed = 0;
+};
+
+// Запрос отклонён при допуске либо снят с очереди при остановке исполнителя
+class QueryRejectedError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Вызывается в потоке обработчика ровно один раз для каждого принятого запроса и не должна бросать исключений.
+// При ошибке запроса documents пуст, а error содержит исключение
+using QueryCallback = std::function<void(std::vector<Document> documents, std::exception_ptr error)>;
+
+// Асинхронное выполнение FindTopDocuments пулом потоков с ограниченной очередью.
+// При перегрузке запрос отклоняется сразу, а не ждёт в растущей очереди: если очередь заполнена
+// или оценка ожидания превышает порог. Ожидание оценивается по числу запросов впереди в полосах
+// того же и более высокого приоритета и сглаженному времени обработки запроса
+class AsyncSearchExecutor {
+public:
+    explicit AsyncSearchExecutor(const SearchServer& search_server, AdmissionOptions options = AdmissionOptions());
+
+    AsyncSearchExecutor(const AsyncSearchExecutor&) = delete;
+    AsyncSearchExecutor& operator=(const AsyncSearchExecutor&) = delete;
+
+    // Дожидается выполняемых запросов. Ожидающие в очереди запросы не выполняются: обработчики
+    // вызывают их callback с QueryRejectedError, деструктор возвращает управление после этого
+    ~AsyncSearchExecutor();
+
+    // Отклонённый запрос возвращает готовый future с QueryRejectedError
+    std::future<std::vector<Document>> Submit(AsyncQuery query);
+
+    // Возвращает false, если запрос отклонён, callback при этом не вызывается
+    bool TrySubmit(AsyncQuery query, QueryCallback callback);
+
+    size_t GetQueueDepth() const;
+
+    // Оценка ожидания обработчика для нового запроса с приоритетом priority
+    std::chrono::nanoseconds GetEstimatedWait(QueryPriority priority) const;
+
+    AdmissionStats GetStats() const;
+
+private:
+    struct Task {
+        AsyncQuery query;
+        QueryCallback callback;
+    };
+
+    const SearchServer& search_server_;
+    const AdmissionOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable tasks_cv_;
+    std::array<std::deque<Task>, QUERY_PRIORITY_COUNT> lanes_;
+    size_t queue_depth_ = 0;
+    bool stopping_ = false;
+
+    std::atomic<int64_t> average_service_ns_{ 0 }; // Экспоненциальное скользящее среднее
+    std::atomic<uint64_t> accepted_{ 0 };
+    std::atomic<uint64_t> rejected_{ 0 };
+    std::atomic<uint64_t> completed_{ 0 };
+
+    std::vector<std::thread> workers_;
+
+    // Вызывается под mutex_
+    std::chrono::nanoseconds EstimateWait(QueryPriority priority) const;
+
+    void RunWorker();
+
+    void Execute(Task& task);
+};
@@ -1,5 +1,10 @@
 #include "document.h"
 
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
 Document::Document()
     : id(0)
     , relevance(0.0)
@@ -14,6 +19,105 @@ Document::Document(int id_doc, double relevance_doc, int rating_doc)
 {
 }
 
+DocumentFilter::DocumentFilter(DocumentStatus status)
+    : statuses{ status }
+{
+}
+
+DocumentFilter& DocumentFilter::WithStatus(DocumentStatus status) {
+    statuses.push_back(status);
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::WithRatingAtLeast(int rating) {
+    min_rating = rating;
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::WithRatingAtMost(int rating) {
+    max_rating = rating;
+    return *this;
+}
+
+bool DocumentFilter::HasRatingRange() const {
+    return min_rating != std::numeric_limits<int>::min() || max_rating != std::numeric_limits<int>::max();
+}
+
+namespace {
+
+// Разбирает поле курсора и возвращает позицию после разделителя, '\0' - последнее поле
+template <typename Integer>
+const char* ParseCursorField(const char* first, const char* last, Integer& value, int base, char delimiter) {
+    const auto [field_end, error] = std::from_chars(first, last, value, base);
+    if (error != std::errc()) {
+        throw std::invalid_argument("invalid search cursor");
+    }
+    if (delimiter == '\0') {
+        if (field_end != last) {
+            throw std::invalid_argument("invalid search cursor");
+        }
+        return field_end;
+    }
+    if (field_end == last || *field_end != delimiter) {
+        throw std::invalid_argument("invalid search cursor");
+    }
+    return field_end + 1;
+}
+
+} // namespace
+
+SearchCursor::SearchCursor(const Document& last_document)
+    : is_start_(false)
+    , relevance_(last_document.relevance)
+    , rating_(last_document.rating)
+    , id_(last_document.id)
+{
+}
+
+bool SearchCursor::IsStart() const {
+    return is_start_;
+}
+
+bool SearchCursor::Precedes(const Document& document) const {
+    return is_start_ || ComesBefore(Document(id_, relevance_, rating_), document);
+}
+
+std::string SearchCursor::Encode() const {
+    if (is_start_) {
+        return {};
+    }
+    uint64_t relevance_bits;
+    std::memcpy(&relevance_bits, &relevance_, sizeof(relevance_bits));
+    char relevance_hex[16];
+    const char* relevance_end = std::to_chars(relevance_hex, relevance_hex + sizeof(relevance_hex), relevance_bits, 16).ptr;
+    return std::string(relevance_hex, relevance_end - relevance_hex) + ':' + std::to_string(rating_) + ':' + std::to_string(id_);
+}
+
+SearchCursor SearchCursor::Decode(std::string_view token) {
+    SearchCursor cursor;
+    if (token.empty()) {
+        return cursor;
+    }
+    const char* last = token.data() + token.size();
+    uint64_t relevance_bits = 0;
+    const char* field_end = ParseCursorField(token.data(), last, relevance_bits, 16, ':');
+    field_end = ParseCursorField(field_end, last, cursor.rating_, 10, ':');
+    ParseCursorField(field_end, last, cursor.id_, 10, '\0');
+    std::memcpy(&cursor.relevance_, &relevance_bits, sizeof(relevance_bits));
+    cursor.is_start_ = false;
+    return cursor;
+}
+
+bool ComesBefore(const Document& lhs, const Document& rhs) {
+    if (lhs.relevance != rhs.relevance) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
 std::ostream& operator<<(std::ostream& output, Document document) {
     output << "{ document_id = " << document.id << ", relevance = " << document.relevance << ", rating = " << document.rating << " }";
     return output;
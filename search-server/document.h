@@ -1,5 +1,10 @@
 #pragma once
 #include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
 
 struct Document {
     int id;
@@ -18,4 +23,65 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+// Фильтр по атрибутам документа, который поисковый сервер применяет через индексы статусов и рейтингов
+struct DocumentFilter {
+    std::vector<DocumentStatus> statuses; // Пустой список - любой статус
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+
+    DocumentFilter() = default;
+
+    explicit DocumentFilter(DocumentStatus status);
+
+    DocumentFilter& WithStatus(DocumentStatus status);
+
+    DocumentFilter& WithRatingAtLeast(int rating);
+
+    DocumentFilter& WithRatingAtMost(int rating);
+
+    bool HasRatingRange() const;
+};
+
+// Какие документы подходят под плюс-слова запроса
+enum class QueryMatchMode {
+    ANY, // хотя бы одно плюс-слово
+    ALL, // все плюс-слова
+};
+
+// Фасетные счётчики документов, подходящих под запрос
+struct MatchAggregation {
+    int total = 0;
+    std::map<DocumentStatus, int> status_counts;
+    std::map<int, int> rating_bucket_counts; // Нижняя граница корзины рейтингов - число документов
+};
+
+// Позиция в выдаче для постраничного поиска: релевантность, рейтинг и ID последнего полученного документа.
+// Выдача упорядочена строго: по убыванию релевантности, затем рейтинга, затем по возрастанию ID
+class SearchCursor {
+public:
+    // Курсор начала выдачи
+    SearchCursor() = default;
+
+    explicit SearchCursor(const Document& last_document);
+
+    bool IsStart() const;
+
+    // Документ идёт в выдаче строго после позиции курсора
+    bool Precedes(const Document& document) const;
+
+    // Строковое представление для передачи клиенту, релевантность сохраняется без потери точности
+    std::string Encode() const;
+
+    static SearchCursor Decode(std::string_view token);
+
+private:
+    bool is_start_ = true;
+    double relevance_ = 0.0;
+    int rating_ = 0;
+    int id_ = 0;
+};
+
+// Строгий порядок выдачи, согласованный с SearchCursor
+bool ComesBefore(const Document& lhs, const Document& rhs);
+
 std::ostream& operator<<(std::ostream& output, Document document);
\ No newline at end of file
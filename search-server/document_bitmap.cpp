@@ -0,0 +1,291 @@
+#include "document_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+bool DocumentBitmap::Block::Contains(uint16_t value) const {
+    if (!bits.empty()) {
+        return (bits[value >> 6] >> (value & 63)) & 1;
+    }
+    return std::binary_search(array.begin(), array.end(), value);
+}
+
+bool DocumentBitmap::Block::Insert(uint16_t value) {
+    if (!bits.empty()) {
+        uint64_t& word = bits[value >> 6];
+        const uint64_t mask = uint64_t{ 1 } << (value & 63);
+        if (word & mask) {
+            return false;
+        }
+        word |= mask;
+        ++count;
+        return true;
+    }
+    const auto it = std::lower_bound(array.begin(), array.end(), value);
+    if (it != array.end() && *it == value) {
+        return false;
+    }
+    array.insert(it, value);
+    ++count;
+    if (count > MAX_ARRAY_SIZE) {
+        ToBits();
+    }
+    return true;
+}
+
+bool DocumentBitmap::Block::Erase(uint16_t value) {
+    if (!bits.empty()) {
+        uint64_t& word = bits[value >> 6];
+        const uint64_t mask = uint64_t{ 1 } << (value & 63);
+        if (!(word & mask)) {
+            return false;
+        }
+        word &= ~mask;
+        --count;
+        // Запас по размеру не даёт блоку переключаться между представлениями на каждой операции
+        if (count <= MAX_ARRAY_SIZE / 2) {
+            Normalize();
+        }
+        return true;
+    }
+    const auto it = std::lower_bound(array.begin(), array.end(), value);
+    if (it == array.end() || *it != value) {
+        return false;
+    }
+    array.erase(it);
+    --count;
+    return true;
+}
+
+void DocumentBitmap::Block::ToBits() {
+    if (!bits.empty()) {
+        return;
+    }
+    bits.assign(BITS_WORD_COUNT, 0);
+    for (const uint16_t value : array) {
+        bits[value >> 6] |= uint64_t{ 1 } << (value & 63);
+    }
+    array.clear();
+    array.shrink_to_fit();
+}
+
+// Пересчитывает количество и переводит блок в массив, если он стал разреженным
+void DocumentBitmap::Block::Normalize() {
+    if (bits.empty()) {
+        count = static_cast<uint32_t>(array.size());
+        return;
+    }
+    count = std::accumulate(bits.begin(), bits.end(), 0u, [](uint32_t sum, uint64_t word) {
+        return sum + static_cast<uint32_t>(__builtin_popcountll(word));
+        });
+    if (count > MAX_ARRAY_SIZE) {
+        return;
+    }
+    array.clear();
+    array.reserve(count);
+    for (size_t word_index = 0; word_index < bits.size(); ++word_index) {
+        for (uint64_t word = bits[word_index]; word != 0; word &= word - 1) {
+            array.push_back(static_cast<uint16_t>(word_index * 64 + __builtin_ctzll(word)));
+        }
+    }
+    bits.clear();
+    bits.shrink_to_fit();
+}
+
+size_t DocumentBitmap::Block::CountIntersection(const Block& other) const {
+    if (!bits.empty() && !other.bits.empty()) {
+        size_t result = 0;
+        for (size_t i = 0; i < BITS_WORD_COUNT; ++i) {
+            result += __builtin_popcountll(bits[i] & other.bits[i]);
+        }
+        return result;
+    }
+    // Массив перебирается с проверкой по другому блоку, из двух массивов - меньший
+    const bool iterate_this = bits.empty() && (!other.bits.empty() || count <= other.count);
+    const Block& array_block = iterate_this ? *this : other;
+    const Block& lookup_block = iterate_this ? other : *this;
+    return std::count_if(array_block.array.begin(), array_block.array.end(), [&lookup_block](uint16_t value) {
+        return lookup_block.Contains(value);
+        });
+}
+
+void DocumentBitmap::Block::IntersectWith(const Block& other) {
+    if (bits.empty()) {
+        array.erase(std::remove_if(array.begin(), array.end(), [&other](uint16_t value) {
+            return !other.Contains(value);
+            }), array.end());
+    }
+    else if (other.bits.empty()) {
+        std::vector<uint16_t> result;
+        std::copy_if(other.array.begin(), other.array.end(), std::back_inserter(result), [this](uint16_t value) {
+            return Contains(value);
+            });
+        bits.clear();
+        bits.shrink_to_fit();
+        array = std::move(result);
+    }
+    else {
+        for (size_t i = 0; i < BITS_WORD_COUNT; ++i) {
+            bits[i] &= other.bits[i];
+        }
+    }
+    Normalize();
+}
+
+void DocumentBitmap::Block::UniteWith(const Block& other) {
+    if (bits.empty() && other.bits.empty() && count + other.count <= MAX_ARRAY_SIZE) {
+        std::vector<uint16_t> result;
+        result.reserve(count + other.count);
+        std::set_union(array.begin(), array.end(), other.array.begin(), other.array.end(), std::back_inserter(result));
+        array = std::move(result);
+    }
+    else {
+        ToBits();
+        if (other.bits.empty()) {
+            for (const uint16_t value : other.array) {
+                bits[value >> 6] |= uint64_t{ 1 } << (value & 63);
+            }
+        }
+        else {
+            for (size_t i = 0; i < BITS_WORD_COUNT; ++i) {
+                bits[i] |= other.bits[i];
+            }
+        }
+    }
+    Normalize();
+}
+
+void DocumentBitmap::Block::Subtract(const Block& other) {
+    if (bits.empty()) {
+        array.erase(std::remove_if(array.begin(), array.end(), [&other](uint16_t value) {
+            return other.Contains(value);
+            }), array.end());
+    }
+    else if (other.bits.empty()) {
+        for (const uint16_t value : other.array) {
+            bits[value >> 6] &= ~(uint64_t{ 1 } << (value & 63));
+        }
+    }
+    else {
+        for (size_t i = 0; i < BITS_WORD_COUNT; ++i) {
+            bits[i] &= ~other.bits[i];
+        }
+    }
+    Normalize();
+}
+
+void DocumentBitmap::Insert(int document_id) {
+    const uint16_t key = GetKey(document_id);
+    auto it = std::lower_bound(blocks_.begin(), blocks_.end(), key, [](const auto& entry, uint16_t value) {
+        return entry.first < value;
+        });
+    if (it == blocks_.end() || it->first != key) {
+        it = blocks_.emplace(it, key, Block());
+    }
+    it->second.Insert(static_cast<uint16_t>(document_id));
+}
+
+void DocumentBitmap::Erase(int document_id) {
+    const uint16_t key = GetKey(document_id);
+    const auto it = std::lower_bound(blocks_.begin(), blocks_.end(), key, [](const auto& entry, uint16_t value) {
+        return entry.first < value;
+        });
+    if (it != blocks_.end() && it->first == key && it->second.Erase(static_cast<uint16_t>(document_id)) && it->second.count == 0) {
+        blocks_.erase(it);
+    }
+}
+
+size_t DocumentBitmap::Count() const {
+    return std::accumulate(blocks_.begin(), blocks_.end(), size_t{ 0 }, [](size_t sum, const auto& entry) {
+        return sum + entry.second.count;
+        });
+}
+
+bool DocumentBitmap::Empty() const {
+    return blocks_.empty();
+}
+
+// Операции над множествами идут слиянием списков блоков по старшим битам ID, пустые блоки удаляются
+size_t DocumentBitmap::CountIntersection(const DocumentBitmap& other) const {
+    size_t count = 0;
+    for (auto it = blocks_.begin(), other_it = other.blocks_.begin(); it != blocks_.end() && other_it != other.blocks_.end();) {
+        if (it->first < other_it->first) {
+            ++it;
+        }
+        else if (other_it->first < it->first) {
+            ++other_it;
+        }
+        else {
+            count += it->second.CountIntersection(other_it->second);
+            ++it;
+            ++other_it;
+        }
+    }
+    return count;
+}
+
+DocumentBitmap& DocumentBitmap::operator&=(const DocumentBitmap& other) {
+    auto output = blocks_.begin();
+    auto other_it = other.blocks_.begin();
+    for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+        while (other_it != other.blocks_.end() && other_it->first < it->first) {
+            ++other_it;
+        }
+        if (other_it == other.blocks_.end() || other_it->first != it->first) {
+            continue;
+        }
+        it->second.IntersectWith(other_it->second);
+        if (it->second.count != 0) {
+            if (output != it) {
+                *output = std::move(*it);
+            }
+            ++output;
+        }
+    }
+    blocks_.erase(output, blocks_.end());
+    return *this;
+}
+
+DocumentBitmap& DocumentBitmap::operator|=(const DocumentBitmap& other) {
+    std::vector<std::pair<uint16_t, Block>> blocks;
+    blocks.reserve(blocks_.size() + other.blocks_.size());
+    auto it = blocks_.begin();
+    auto other_it = other.blocks_.begin();
+    while (it != blocks_.end() || other_it != other.blocks_.end()) {
+        if (other_it == other.blocks_.end() || (it != blocks_.end() && it->first < other_it->first)) {
+            blocks.push_back(std::move(*it++));
+        }
+        else if (it == blocks_.end() || other_it->first < it->first) {
+            blocks.push_back(*other_it++);
+        }
+        else {
+            it->second.UniteWith(other_it->second);
+            blocks.push_back(std::move(*it++));
+            ++other_it;
+        }
+    }
+    blocks_ = std::move(blocks);
+    return *this;
+}
+
+DocumentBitmap& DocumentBitmap::operator-=(const DocumentBitmap& other) {
+    auto output = blocks_.begin();
+    auto other_it = other.blocks_.begin();
+    for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+        while (other_it != other.blocks_.end() && other_it->first < it->first) {
+            ++other_it;
+        }
+        if (other_it != other.blocks_.end() && other_it->first == it->first) {
+            it->second.Subtract(other_it->second);
+        }
+        if (it->second.count != 0) {
+            if (output != it) {
+                *output = std::move(*it);
+            }
+            ++output;
+        }
+    }
+    blocks_.erase(output, blocks_.end());
+    return *this;
+}
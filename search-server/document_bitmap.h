@@ -0,0 +1,95 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Множество ID документов в стиле Roaring: пространство ID делится на блоки по 2^16 значений,
+// разреженный блок хранится отсортированным массивом младших 16 бит, плотный - битовой картой.
+// Хранятся только непустые блоки - парами старшие биты ID и блок, отсортированными по старшим битам
+class DocumentBitmap {
+public:
+    void Insert(int document_id);
+
+    void Erase(int document_id);
+
+    bool Contains(int document_id) const {
+        const Block* block = FindBlock(GetKey(document_id));
+        return block != nullptr && block->Contains(static_cast<uint16_t>(document_id));
+    }
+
+    size_t Count() const;
+
+    bool Empty() const;
+
+    // Мощность пересечения без построения самого пересечения
+    size_t CountIntersection(const DocumentBitmap& other) const;
+
+    DocumentBitmap& operator&=(const DocumentBitmap& other);
+    DocumentBitmap& operator|=(const DocumentBitmap& other);
+    DocumentBitmap& operator-=(const DocumentBitmap& other);
+
+    // Вызывает function для каждого ID в порядке возрастания
+    template <typename Function>
+    void ForEach(Function function) const;
+
+private:
+    static const uint32_t MAX_ARRAY_SIZE = 4096;
+    static const uint32_t BITS_WORD_COUNT = 1024;
+
+    struct Block {
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bits; // Пусто, пока блок хранится массивом
+        uint32_t count = 0;
+
+        bool Contains(uint16_t value) const;
+        bool Insert(uint16_t value);
+        bool Erase(uint16_t value);
+        void ToBits();
+        void Normalize();
+
+        size_t CountIntersection(const Block& other) const;
+        void IntersectWith(const Block& other);
+        void UniteWith(const Block& other);
+        void Subtract(const Block& other);
+    };
+
+    std::vector<std::pair<uint16_t, Block>> blocks_;
+
+    static uint16_t GetKey(int document_id) {
+        return static_cast<uint16_t>(static_cast<uint32_t>(document_id) >> 16);
+    }
+
+    const Block* FindBlock(uint16_t key) const {
+        size_t first = 0;
+        size_t last = blocks_.size();
+        while (first < last) {
+            const size_t middle = first + (last - first) / 2;
+            if (blocks_[middle].first < key) {
+                first = middle + 1;
+            }
+            else {
+                last = middle;
+            }
+        }
+        return first < blocks_.size() && blocks_[first].first == key ? &blocks_[first].second : nullptr;
+    }
+};
+
+template <typename Function>
+void DocumentBitmap::ForEach(Function function) const {
+    for (const auto& [key, block] : blocks_) {
+        const int base = static_cast<int>(static_cast<uint32_t>(key) << 16);
+        if (block.bits.empty()) {
+            for (const uint16_t value : block.array) {
+                function(base | value);
+            }
+            continue;
+        }
+        for (size_t word_index = 0; word_index < block.bits.size(); ++word_index) {
+            for (uint64_t word = block.bits[word_index]; word != 0; word &= word - 1) {
+                function(base | static_cast<int>(word_index * 64 + __builtin_ctzll(word)));
+            }
+        }
+    }
+}
@@ -0,0 +1,24 @@
+#include "document_column.h"
+
+void DocumentColumn::Set(int document_id, int value) {
+    const uint32_t page_key = static_cast<uint32_t>(document_id) >> PAGE_BITS;
+    const auto it = std::lower_bound(page_keys_.begin(), page_keys_.end(), page_key);
+    const size_t page_index = it - page_keys_.begin();
+    if (it == page_keys_.end() || *it != page_key) {
+        page_keys_.insert(it, page_key);
+        pages_.insert(pages_.begin() + page_index, Page());
+    }
+    Page& page = pages_[page_index];
+    page.values[static_cast<uint32_t>(document_id) & PAGE_MASK] = value;
+    ++page.count;
+}
+
+void DocumentColumn::Erase(int document_id) {
+    const uint32_t page_key = static_cast<uint32_t>(document_id) >> PAGE_BITS;
+    const auto it = std::lower_bound(page_keys_.begin(), page_keys_.end(), page_key);
+    const size_t page_index = it - page_keys_.begin();
+    if (--pages_[page_index].count == 0) {
+        page_keys_.erase(it);
+        pages_.erase(pages_.begin() + page_index);
+    }
+}
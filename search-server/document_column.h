@@ -0,0 +1,35 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Столбец целых значений по ID документа. Пространство ID делится на страницы по 2^PAGE_BITS значений,
+// хранятся только страницы с документами. Значение находится двоичным поиском страницы по отсортированным
+// номерам страниц и обращением по индексу внутри неё
+class DocumentColumn {
+public:
+    void Set(int document_id, int value);
+
+    // Документ должен быть в столбце. Пустая страница освобождается
+    void Erase(int document_id);
+
+    // Значение документа, который есть в столбце
+    int Get(int document_id) const {
+        const uint32_t page_key = static_cast<uint32_t>(document_id) >> PAGE_BITS;
+        const auto it = std::lower_bound(page_keys_.begin(), page_keys_.end(), page_key);
+        return pages_[it - page_keys_.begin()].values[static_cast<uint32_t>(document_id) & PAGE_MASK];
+    }
+
+private:
+    static const uint32_t PAGE_BITS = 10;
+    static const uint32_t PAGE_MASK = (uint32_t{ 1 } << PAGE_BITS) - 1;
+
+    struct Page {
+        std::vector<int> values = std::vector<int>(size_t{ 1 } << PAGE_BITS);
+        uint32_t count = 0; // Документов на странице
+    };
+
+    std::vector<uint32_t> page_keys_;
+    std::vector<Page> pages_;
+};
@@ -0,0 +1,46 @@
+#include "document_fingerprint.h"
+
+namespace {
+
+uint64_t HashWord(std::string_view word, uint64_t seed) {
+    uint64_t hash = seed;
+    for (const char c : word) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Финализатор splitmix64: перемешивает биты, чтобы сумма хешей оставалась равномерной
+uint64_t MixHash(uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebull;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+} // namespace
+
+uint64_t ComputeWordHash(std::string_view word) {
+    return MixHash(HashWord(word, 0xcbf29ce484222325ull));
+}
+
+void DocumentFingerprint::AddWord(std::string_view word) {
+    // Сумма по модулю 2^64 коммутативна, поэтому порядок слов не важен
+    high += ComputeWordHash(word);
+    low += MixHash(HashWord(word, 0x84222325cbf29ce4ull) + word.size());
+}
+
+bool operator==(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs) {
+    return lhs.high == rhs.high && lhs.low == rhs.low;
+}
+
+bool operator!=(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs) {
+    return !(lhs == rhs);
+}
+
+size_t DocumentFingerprintHasher::operator()(const DocumentFingerprint& fingerprint) const {
+    return static_cast<size_t>(fingerprint.high ^ (fingerprint.low * 0x9e3779b97f4a7c15ull));
+}
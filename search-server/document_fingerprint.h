@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+// 128-битный отпечаток множества слов документа.
+// Не зависит от порядка добавления слов, каждое слово должно добавляться один раз.
+struct DocumentFingerprint {
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    void AddWord(std::string_view word);
+};
+
+// 64-битный хеш слова, общий для отпечатков и сигнатур MinHash
+uint64_t ComputeWordHash(std::string_view word);
+
+bool operator==(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs);
+bool operator!=(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs);
+
+struct DocumentFingerprintHasher {
+    size_t operator()(const DocumentFingerprint& fingerprint) const;
+};
+
+// Отпечаток по словам контейнера частот слов (результат GetWordFrequencies)
+template <typename WordFrequencies>
+DocumentFingerprint ComputeWordSetFingerprint(const WordFrequencies& word_frequencies) {
+    DocumentFingerprint fingerprint;
+    for (const auto& [word, _] : word_frequencies) {
+        fingerprint.AddWord(word);
+    }
+    return fingerprint;
+}
@@ -0,0 +1,115 @@
+#include "fuzzy_term_index.h"
+#include "document_fingerprint.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// Байтовые смещения начал кодовых точек UTF-8 и длина строки в конце
+std::vector<size_t> GetCodePointOffsets(std::string_view text) {
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if ((static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) {
+            offsets.push_back(i);
+        }
+    }
+    offsets.push_back(text.size());
+    return offsets;
+}
+
+// Кодовые точки как подстроки: для сравнения символов достаточно равенства их байтов
+std::vector<std::string_view> SplitIntoCodePoints(std::string_view text) {
+    const auto offsets = GetCodePointOffsets(text);
+    std::vector<std::string_view> code_points;
+    code_points.reserve(offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        code_points.push_back(text.substr(offsets[i], offsets[i + 1] - offsets[i]));
+    }
+    return code_points;
+}
+
+}
+
+FuzzyTermIndex::FuzzyTermIndex(int max_edit_distance)
+    : max_edit_distance_(max_edit_distance) {
+}
+
+void FuzzyTermIndex::AddTerm(int term_id, std::string_view term) {
+    for (const uint64_t delete_hash : GenerateDeletes(term)) {
+        delete_to_term_ids_.emplace(delete_hash, term_id);
+    }
+}
+
+void FuzzyTermIndex::RemoveTerm(int term_id, std::string_view term) {
+    for (const uint64_t delete_hash : GenerateDeletes(term)) {
+        const auto [first, last] = delete_to_term_ids_.equal_range(delete_hash);
+        const auto it = std::find_if(first, last, [term_id](const auto& entry) {
+            return entry.second == term_id;
+            });
+        if (it != last) {
+            delete_to_term_ids_.erase(it);
+        }
+    }
+}
+
+size_t FuzzyTermIndex::GetDeleteCount() const {
+    return delete_to_term_ids_.size();
+}
+
+std::vector<uint64_t> FuzzyTermIndex::GenerateDeletes(std::string_view word) const {
+    std::vector<std::string> level = { std::string(word) };
+    std::vector<uint64_t> hashes = { ComputeWordHash(word) };
+    for (int distance = 1; distance <= max_edit_distance_; ++distance) {
+        std::vector<std::string> next_level;
+        for (const std::string& text : level) {
+            const auto offsets = GetCodePointOffsets(text);
+            for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+                std::string deleted = text.substr(0, offsets[i]) + text.substr(offsets[i + 1]);
+                const uint64_t hash = ComputeWordHash(deleted);
+                if (std::find(hashes.begin(), hashes.end(), hash) == hashes.end()) {
+                    hashes.push_back(hash);
+                    next_level.push_back(std::move(deleted));
+                }
+            }
+        }
+        level = std::move(next_level);
+    }
+    return hashes;
+}
+
+int FuzzyTermIndex::ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance) {
+    const auto lhs_chars = SplitIntoCodePoints(lhs);
+    const auto rhs_chars = SplitIntoCodePoints(rhs);
+    const int lhs_size = static_cast<int>(lhs_chars.size());
+    const int rhs_size = static_cast<int>(rhs_chars.size());
+    if (std::abs(lhs_size - rhs_size) > max_distance) {
+        return max_distance + 1;
+    }
+    // Три последние строки таблицы: перестановка смотрит на две строки назад
+    std::vector<int> before_previous(rhs_size + 1);
+    std::vector<int> previous(rhs_size + 1);
+    std::vector<int> current(rhs_size + 1);
+    for (int j = 0; j <= rhs_size; ++j) {
+        previous[j] = j;
+    }
+    for (int i = 1; i <= lhs_size; ++i) {
+        current[0] = i;
+        int row_min = current[0];
+        for (int j = 1; j <= rhs_size; ++j) {
+            const int cost = lhs_chars[i - 1] == rhs_chars[j - 1] ? 0 : 1;
+            current[j] = std::min({ previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost });
+            if (i > 1 && j > 1 && lhs_chars[i - 1] == rhs_chars[j - 2] && lhs_chars[i - 2] == rhs_chars[j - 1]) {
+                current[j] = std::min(current[j], before_previous[j - 2] + 1);
+            }
+            row_min = std::min(row_min, current[j]);
+        }
+        if (row_min > max_distance) {
+            return max_distance + 1;
+        }
+        std::swap(before_previous, previous);
+        std::swap(previous, current);
+    }
+    return std::min(previous[rhs_size], max_distance + 1);
+}
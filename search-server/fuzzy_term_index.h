@@ -0,0 +1,69 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct FuzzySearchOptions {
+    int max_edit_distance = 2;     // 1 или 2
+    size_t max_suggestions = 3;    // Замен одного неизвестного слова, ближайшие и самые частые первыми
+    double distance_penalty = 0.5; // Множитель веса замены за каждую правку
+};
+
+struct FuzzySuggestion {
+    int term_id;
+    int distance;
+};
+
+// Индекс симметричного удаления (SymSpell): для каждого слова словаря хранятся хеши всех строк,
+// получаемых удалением до max_edit_distance символов. Слова на расстоянии не больше max_edit_distance
+// от слова запроса имеют с ним общую строку удалений, поэтому поиск замен - это перебор удалений
+// слова запроса и проверка найденных кандидатов расстоянием Дамерау-Левенштейна.
+// Символы - кодовые точки UTF-8, а не байты
+class FuzzyTermIndex {
+public:
+    explicit FuzzyTermIndex(int max_edit_distance = 2);
+
+    void AddTerm(int term_id, std::string_view term);
+
+    void RemoveTerm(int term_id, std::string_view term);
+
+    // Слова словаря на расстоянии от 1 до max_edit_distance от word. term_id_to_word - тексты слов по ID
+    template <typename TermIdToWord>
+    std::vector<FuzzySuggestion> FindSuggestions(std::string_view word, const TermIdToWord& term_id_to_word) const;
+
+    size_t GetDeleteCount() const;
+
+    // Расстояние Дамерау-Левенштейна (с перестановкой соседних символов) по кодовым точкам UTF-8,
+    // при расстоянии больше max_distance возвращает max_distance + 1
+    static int ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance);
+
+private:
+    int max_edit_distance_;
+    std::unordered_multimap<uint64_t, int> delete_to_term_ids_; // Хеш строки удалений - ID слова
+
+    // Хеши word и всех строк удалений без повторов
+    std::vector<uint64_t> GenerateDeletes(std::string_view word) const;
+};
+
+template <typename TermIdToWord>
+std::vector<FuzzySuggestion> FuzzyTermIndex::FindSuggestions(std::string_view word, const TermIdToWord& term_id_to_word) const {
+    std::vector<FuzzySuggestion> suggestions;
+    std::vector<int> checked_term_ids;
+    for (const uint64_t delete_hash : GenerateDeletes(word)) {
+        const auto [first, last] = delete_to_term_ids_.equal_range(delete_hash);
+        for (auto it = first; it != last; ++it) {
+            checked_term_ids.push_back(it->second);
+        }
+    }
+    std::sort(checked_term_ids.begin(), checked_term_ids.end());
+    checked_term_ids.erase(std::unique(checked_term_ids.begin(), checked_term_ids.end()), checked_term_ids.end());
+    for (const int term_id : checked_term_ids) {
+        const int distance = ComputeEditDistance(word, term_id_to_word[term_id], max_edit_distance_);
+        if (distance > 0 && distance <= max_edit_distance_) {
+            suggestions.push_back({ term_id, distance });
+        }
+    }
+    return suggestions;
+}
@@ -0,0 +1,128 @@
+#include "impact_index.h"
+#include "metrics.h"
+#include "scoring.h"
+
+#include <algorithm>
+#include <execution>
+#include <iterator>
+
+void ImpactIndex::Build(const std::pmr::map<std::string_view, std::pmr::map<int, double>>& word_to_document_freqs, int document_count, ImpactPrecision precision) {
+    Clear();
+    precision_ = precision;
+
+    std::vector<std::pair<const std::pmr::map<int, double>*, Postings*>> words;
+    words.reserve(word_to_document_freqs.size());
+    for (const auto& [word, id_freqs] : word_to_document_freqs) {
+        words.emplace_back(&id_freqs, &word_to_postings_[word]);
+    }
+
+    const auto compute_weight = [document_count](const std::pmr::map<int, double>& id_freqs) {
+        return TfIdfScoring::ComputeTermWeight(document_count, static_cast<int>(id_freqs.size()));
+    };
+    const double max_impact = std::transform_reduce(std::execution::par, words.begin(), words.end(), 0.0,
+        [](double lhs, double rhs) { return std::max(lhs, rhs); },
+        [&compute_weight](const auto& word) {
+            const double term_weight = compute_weight(*word.first);
+            double max_term_freq = 0.0;
+            for (const auto& [_, term_freq] : *word.first) {
+                max_term_freq = std::max(max_term_freq, term_freq);
+            }
+            return max_term_freq * term_weight;
+        });
+
+    const uint32_t max_quantized = precision == ImpactPrecision::UINT8 ? UINT8_MAX : UINT16_MAX;
+    scale_ = max_impact > 0.0 ? max_impact / max_quantized : 0.0;
+
+    std::for_each(std::execution::par, words.begin(), words.end(), [this, &compute_weight, max_quantized](const auto& word) {
+        const double term_weight = compute_weight(*word.first);
+        Postings& postings = *word.second;
+        postings.document_ids.reserve(word.first->size());
+        for (const auto& [document_id, term_freq] : *word.first) {
+            const double impact = TfIdfScoring::Score(term_freq, term_weight, 0.0, 0.0);
+            uint32_t quantized = scale_ > 0.0 ? static_cast<uint32_t>(impact / scale_ + 0.5) : 0;
+            // Ненулевой вклад не должен обнуляться при округлении
+            quantized = std::min(std::max(quantized, impact > 0.0 ? 1u : 0u), max_quantized);
+            postings.document_ids.push_back(document_id);
+            if (precision_ == ImpactPrecision::UINT8) {
+                postings.impacts8.push_back(static_cast<uint8_t>(quantized));
+            }
+            else {
+                postings.impacts16.push_back(static_cast<uint16_t>(quantized));
+            }
+        }
+        });
+    built_ = true;
+}
+
+void ImpactIndex::Clear() {
+    word_to_postings_.clear();
+    scale_ = 0.0;
+    built_ = false;
+}
+
+bool ImpactIndex::Empty() const {
+    return !built_;
+}
+
+double ImpactIndex::GetScale() const {
+    return scale_;
+}
+
+ImpactPrecision ImpactIndex::GetPrecision() const {
+    return precision_;
+}
+
+template <typename Impact>
+void ImpactIndex::MergeScores(const std::vector<int>& document_ids, const std::vector<Impact>& impacts, size_t first, size_t last, DocumentScores& scores) {
+    DocumentScores merged;
+    merged.reserve(scores.size() + (last - first));
+    auto it = scores.begin();
+    for (size_t i = first; i < last; ++i) {
+        for (; it != scores.end() && it->first < document_ids[i]; ++it) {
+            merged.push_back(*it);
+        }
+        if (it != scores.end() && it->first == document_ids[i]) {
+            merged.emplace_back(document_ids[i], it->second + impacts[i]);
+            ++it;
+        }
+        else {
+            merged.emplace_back(document_ids[i], impacts[i]);
+        }
+    }
+    std::copy(it, scores.end(), std::back_inserter(merged));
+    scores = std::move(merged);
+}
+
+ImpactIndex::DocumentScores ImpactIndex::Accumulate(const std::vector<std::string_view>& words, int first_id, int last_id) const {
+    DocumentScores scores;
+    for (const auto word : words) {
+        const auto it = word_to_postings_.find(word);
+        if (it == word_to_postings_.end()) {
+            continue;
+        }
+        const auto& document_ids = it->second.document_ids;
+        const size_t first = std::lower_bound(document_ids.begin(), document_ids.end(), first_id) - document_ids.begin();
+        const size_t last = std::upper_bound(document_ids.begin() + first, document_ids.end(), last_id) - document_ids.begin();
+        ADD_TO_COUNTER(MetricCounter::POSTINGS_SCANNED, last - first);
+        if (precision_ == ImpactPrecision::UINT8) {
+            MergeScores(document_ids, it->second.impacts8, first, last, scores);
+        }
+        else {
+            MergeScores(document_ids, it->second.impacts16, first, last, scores);
+        }
+    }
+    return scores;
+}
+
+void ImpactIndex::Exclude(const std::vector<std::string_view>& words, DocumentScores& scores) const {
+    for (const auto word : words) {
+        const auto it = word_to_postings_.find(word);
+        if (it == word_to_postings_.end()) {
+            continue;
+        }
+        const auto& document_ids = it->second.document_ids;
+        scores.erase(std::remove_if(scores.begin(), scores.end(), [&document_ids](const auto& score) {
+            return std::binary_search(document_ids.begin(), document_ids.end(), score.first);
+            }), scores.end());
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+enum class ImpactPrecision {
+    UINT8,
+    UINT16,
+};
+
+// Неизменяемый индекс вкладов слов: для каждого вхождения слова хранится TF-IDF, квантованный до 8 или 16 бит
+// с общим для всего индекса масштабом. Вклады нескольких слов складываются как целые числа,
+// в double переводится только итоговая сумма.
+class ImpactIndex {
+public:
+    using DocumentScores = std::vector<std::pair<int, uint32_t>>; // ID документа и сумма вкладов, по возрастанию ID
+
+    void Build(const std::pmr::map<std::string_view, std::pmr::map<int, double>>& word_to_document_freqs, int document_count, ImpactPrecision precision);
+
+    void Clear();
+
+    bool Empty() const;
+
+    // Суммы вкладов слов для документов с ID из [first_id, last_id]
+    DocumentScores Accumulate(const std::vector<std::string_view>& words, int first_id, int last_id) const;
+
+    // Удаляет из scores документы, содержащие хотя бы одно из слов
+    void Exclude(const std::vector<std::string_view>& words, DocumentScores& scores) const;
+
+    double GetScale() const;
+
+    ImpactPrecision GetPrecision() const;
+
+private:
+    struct Postings {
+        std::vector<int> document_ids;
+        std::vector<uint8_t> impacts8;   // Заполнен при ImpactPrecision::UINT8
+        std::vector<uint16_t> impacts16; // Заполнен при ImpactPrecision::UINT16
+    };
+
+    std::map<std::string_view, Postings> word_to_postings_;
+    ImpactPrecision precision_ = ImpactPrecision::UINT8;
+    double scale_ = 0.0;
+    bool built_ = false;
+
+    template <typename Impact>
+    static void MergeScores(const std::vector<int>& document_ids, const std::vector<Impact>& impacts, size_t first, size_t last, DocumentScores& scores);
+};
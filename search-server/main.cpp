@@ -1,7 +1,7 @@
 #include "paginator.h"
 #include "request_queue.h"
 #include "read_input_functions.h"
-//#include "log_duration.h"
+#include "metrics.h"
 #include "remove_duplicates.h"
 #include "test_example_functions.h"
 
@@ -195,4 +195,7 @@ int main() {
             PrintMatchDocumentResult(document_id, words, status);
         }
     }
+
+    // Длительности стадий и счётчики за время работы примеров
+    cout << TakeMetricsSnapshot();
 }
\ No newline at end of file
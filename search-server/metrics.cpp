@@ -0,0 +1,154 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+
+using namespace std::literals;
+
+namespace {
+
+const size_t METRICS_SHARD_COUNT = 8;
+
+// Шард занимает отдельные строки кэша, чтобы потоки не делили их при записи
+struct alignas(64) MetricsShard {
+    std::array<std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT>, METRIC_STAGE_COUNT> buckets;
+    std::array<std::atomic<uint64_t>, METRIC_STAGE_COUNT> totals_ns;
+    std::array<std::atomic<uint64_t>, METRIC_COUNTER_COUNT> counters;
+};
+
+// Статические атомарные счётчики инициализируются нулями до запуска программы
+std::array<MetricsShard, METRICS_SHARD_COUNT> metrics_shards;
+std::atomic<size_t> next_shard_index{ 0 };
+
+MetricsShard& GetThreadShard() {
+    thread_local const size_t shard_index = next_shard_index.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARD_COUNT;
+    return metrics_shards[shard_index];
+}
+
+} // namespace
+
+std::string_view GetMetricStageName(MetricStage stage) {
+    static const std::array<std::string_view, METRIC_STAGE_COUNT> names = {
+        "parse_query"sv, "scoring"sv, "top_k"sv, "match_document"sv, "add_document"sv, "remove_document"sv,
+    };
+    return names[static_cast<size_t>(stage)];
+}
+
+std::string_view GetMetricCounterName(MetricCounter counter) {
+    static const std::array<std::string_view, METRIC_COUNTER_COUNT> names = {
+        "postings_scanned"sv, "documents_scored"sv, "champion_list_hits"sv, "near_duplicate_checks"sv,
+    };
+    return names[static_cast<size_t>(counter)];
+}
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    value = std::min(value, (uint64_t{ 1 } << MAX_VALUE_BITS) - 1);
+    const size_t shift = (63 - __builtin_clzll(value)) - (SUB_BUCKET_BITS - 1);
+    const size_t mantissa = static_cast<size_t>(value >> shift);
+    return SUB_BUCKET_COUNT + (shift - 1) * HALF_SUB_BUCKET_COUNT + (mantissa - HALF_SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const size_t offset = index - SUB_BUCKET_COUNT;
+    const size_t shift = offset / HALF_SUB_BUCKET_COUNT + 1;
+    const uint64_t mantissa = offset % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+std::chrono::nanoseconds StageMetrics::GetQuantile(double quantile) const {
+    if (count == 0) {
+        return 0ns;
+    }
+    const uint64_t rank = std::clamp<uint64_t>(static_cast<uint64_t>(std::ceil(quantile * count)), 1, count);
+    uint64_t seen = 0;
+    for (size_t index = 0; index < buckets.size(); ++index) {
+        seen += buckets[index];
+        if (seen >= rank) {
+            return std::chrono::nanoseconds(LatencyHistogram::GetBucketUpperBound(index));
+        }
+    }
+    return std::chrono::nanoseconds(LatencyHistogram::GetBucketUpperBound(buckets.size() - 1));
+}
+
+const StageMetrics& MetricsSnapshot::operator[](MetricStage stage) const {
+    return stages[static_cast<size_t>(stage)];
+}
+
+uint64_t MetricsSnapshot::operator[](MetricCounter counter) const {
+    return counters[static_cast<size_t>(counter)];
+}
+
+void RecordLatency(MetricStage stage, std::chrono::nanoseconds duration) {
+    MetricsShard& shard = GetThreadShard();
+    const uint64_t value = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+    const size_t stage_index = static_cast<size_t>(stage);
+    shard.buckets[stage_index][LatencyHistogram::GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.totals_ns[stage_index].fetch_add(value, std::memory_order_relaxed);
+}
+
+void AddToCounter(MetricCounter counter, uint64_t value) {
+    GetThreadShard().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+MetricsSnapshot TakeMetricsSnapshot() {
+    MetricsSnapshot snapshot;
+    for (const MetricsShard& shard : metrics_shards) {
+        for (size_t stage_index = 0; stage_index < METRIC_STAGE_COUNT; ++stage_index) {
+            StageMetrics& stage = snapshot.stages[stage_index];
+            for (size_t index = 0; index < LatencyHistogram::BUCKET_COUNT; ++index) {
+                const uint64_t bucket_count = shard.buckets[stage_index][index].load(std::memory_order_relaxed);
+                stage.buckets[index] += bucket_count;
+                stage.count += bucket_count;
+            }
+            stage.total_ns += shard.totals_ns[stage_index].load(std::memory_order_relaxed);
+        }
+        for (size_t counter_index = 0; counter_index < METRIC_COUNTER_COUNT; ++counter_index) {
+            snapshot.counters[counter_index] += shard.counters[counter_index].load(std::memory_order_relaxed);
+        }
+    }
+    return snapshot;
+}
+
+void ResetMetrics() {
+    for (MetricsShard& shard : metrics_shards) {
+        for (auto& stage_buckets : shard.buckets) {
+            for (auto& bucket : stage_buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto& total_ns : shard.totals_ns) {
+            total_ns.store(0, std::memory_order_relaxed);
+        }
+        for (auto& counter : shard.counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::ostream& operator<<(std::ostream& output, const MetricsSnapshot& snapshot) {
+    const auto to_microseconds = [](std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+    const auto flags = output.flags();
+    output << std::fixed << std::setprecision(1);
+    for (size_t stage_index = 0; stage_index < METRIC_STAGE_COUNT; ++stage_index) {
+        const StageMetrics& stage = snapshot.stages[stage_index];
+        output << GetMetricStageName(static_cast<MetricStage>(stage_index)) << ": count = "sv << stage.count
+            << ", p50 = "sv << to_microseconds(stage.GetQuantile(0.5)) << " us"sv
+            << ", p99 = "sv << to_microseconds(stage.GetQuantile(0.99)) << " us"sv
+            << ", p999 = "sv << to_microseconds(stage.GetQuantile(0.999)) << " us"sv << '\n';
+    }
+    for (size_t counter_index = 0; counter_index < METRIC_COUNTER_COUNT; ++counter_index) {
+        output << GetMetricCounterName(static_cast<MetricCounter>(counter_index)) << ": "sv << snapshot.counters[counter_index] << '\n';
+    }
+    output.flags(flags);
+    return output;
+}
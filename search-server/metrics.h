@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#define METRICS_CONCAT_INTERNAL(X, Y) X##Y
+#define METRICS_CONCAT(X, Y) METRICS_CONCAT_INTERNAL(X, Y)
+
+// MEASURE_STAGE замеряет время от своего вызова до конца блока и добавляет его в гистограмму стадии.
+// При SEARCH_SERVER_DISABLE_METRICS макросы метрик не генерируют кода
+#ifdef SEARCH_SERVER_DISABLE_METRICS
+#define MEASURE_STAGE(stage)
+#define ADD_TO_COUNTER(counter, value)
+#else
+#define MEASURE_STAGE(stage) StageTimer METRICS_CONCAT(stage_timer, __LINE__)(stage)
+#define ADD_TO_COUNTER(counter, value) AddToCounter(counter, value)
+#endif
+
+// Стадии обработки запросов, для каждой ведётся гистограмма длительностей
+enum class MetricStage {
+    PARSE_QUERY,
+    SCORING,
+    TOP_K,
+    MATCH_DOCUMENT,
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+};
+
+enum class MetricCounter {
+    POSTINGS_SCANNED,
+    DOCUMENTS_SCORED,
+    CHAMPION_LIST_HITS,     // Запросы, выданные по спискам чемпионов без обхода списка документов слова
+    NEAR_DUPLICATE_CHECKS,  // Точные сравнения кандидатов в почти дубликаты
+};
+
+const size_t METRIC_STAGE_COUNT = 6;
+const size_t METRIC_COUNTER_COUNT = 4;
+
+std::string_view GetMetricStageName(MetricStage stage);
+
+std::string_view GetMetricCounterName(MetricCounter counter);
+
+// Логарифмически-линейная гистограмма в стиле HDR: каждая степень двойки наносекунд делится
+// на 16 корзин, поэтому относительная погрешность значения не превышает 1/16
+class LatencyHistogram {
+public:
+    static const size_t SUB_BUCKET_BITS = 5;
+    static const size_t SUB_BUCKET_COUNT = size_t{ 1 } << SUB_BUCKET_BITS;
+    static const size_t HALF_SUB_BUCKET_COUNT = SUB_BUCKET_COUNT / 2;
+    static const size_t MAX_VALUE_BITS = 40; // Значения от 2^40 нс (около 18 минут) попадают в последнюю корзину
+    static const size_t BUCKET_COUNT = SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * HALF_SUB_BUCKET_COUNT;
+
+    static size_t GetBucketIndex(uint64_t value);
+
+    // Наибольшее значение, попадающее в корзину
+    static uint64_t GetBucketUpperBound(size_t index);
+};
+
+// Копия гистограммы одной стадии на момент снимка
+struct StageMetrics {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(LatencyHistogram::BUCKET_COUNT);
+
+    // Верхняя граница корзины, в которую попадает квантиль quantile
+    std::chrono::nanoseconds GetQuantile(double quantile) const;
+};
+
+struct MetricsSnapshot {
+    std::array<StageMetrics, METRIC_STAGE_COUNT> stages;
+    std::array<uint64_t, METRIC_COUNTER_COUNT> counters = {};
+
+    const StageMetrics& operator[](MetricStage stage) const;
+
+    uint64_t operator[](MetricCounter counter) const;
+};
+
+// Запись идёт без блокировок: каждый поток пишет в свой шард атомарных счётчиков,
+// шарды суммируются только при снятии снимка
+void RecordLatency(MetricStage stage, std::chrono::nanoseconds duration);
+
+void AddToCounter(MetricCounter counter, uint64_t value);
+
+MetricsSnapshot TakeMetricsSnapshot();
+
+void ResetMetrics();
+
+// Выводит по строке на стадию: число замеров, p50, p99 и p999 в микросекундах, затем счётчики
+std::ostream& operator<<(std::ostream& output, const MetricsSnapshot& snapshot);
+
+class StageTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit StageTimer(MetricStage stage)
+        : stage_(stage) {
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer() {
+        RecordLatency(stage_, Clock::now() - start_time_);
+    }
+
+private:
+    const MetricStage stage_;
+    const Clock::time_point start_time_ = Clock::now();
+};
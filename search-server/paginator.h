@@ -4,6 +4,7 @@
 #include <vector>
 #include <iterator>
 #include <cassert>
+#include <cstddef>
 
 template <typename Iterator>
 class Page {
@@ -67,6 +68,95 @@ auto Paginate(const Container& c, size_t page_size) {
     return Paginator(std::begin(c), std::end(c), page_size);
 }
 
+// Ленивая постраничная выдача: страницы запрашиваются у источника по мере обхода, а не нарезаются из готового вектора.
+// fetch_page(cursor, page_size) возвращает страницу после курсора, курсор следующей страницы строится
+// по последнему элементу текущей: Cursor(page.back()). Пустая страница означает конец выдачи
+template <typename Cursor, typename FetchPage>
+class LazyPaginator {
+public:
+    using PageType = decltype(std::declval<FetchPage&>()(std::declval<const Cursor&>(), std::size_t{}));
+
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = PageType;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const PageType*;
+        using reference = const PageType&;
+
+        Iterator() = default;
+
+        explicit Iterator(LazyPaginator* paginator)
+            : paginator_(paginator)
+            , page_(paginator->GetPageAfter(Cursor())) {
+            if (std::empty(page_)) {
+                paginator_ = nullptr;
+            }
+        }
+
+        reference operator*() const {
+            return page_;
+        }
+
+        pointer operator->() const {
+            return &page_;
+        }
+
+        Iterator& operator++() {
+            if (std::size(page_) < paginator_->page_size_) {
+                paginator_ = nullptr;
+                page_ = PageType();
+                return *this;
+            }
+            page_ = paginator_->GetPageAfter(Cursor(page_.back()));
+            if (std::empty(page_)) {
+                paginator_ = nullptr;
+            }
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return paginator_ == other.paginator_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        LazyPaginator* paginator_ = nullptr;
+        PageType page_;
+    };
+
+    LazyPaginator(FetchPage fetch_page, std::size_t page_size)
+        : fetch_page_(std::move(fetch_page))
+        , page_size_(page_size) {
+        assert(page_size > 0);
+    }
+
+    Iterator begin() {
+        return Iterator(this);
+    }
+
+    Iterator end() {
+        return Iterator();
+    }
+
+    // Страница после курсора, полученного клиентом с предыдущей страницей
+    PageType GetPageAfter(const Cursor& cursor) {
+        return fetch_page_(cursor, page_size_);
+    }
+
+private:
+    FetchPage fetch_page_;
+    std::size_t page_size_;
+};
+
+template <typename Cursor, typename FetchPage>
+auto PaginateLazily(FetchPage fetch_page, std::size_t page_size) {
+    return LazyPaginator<Cursor, FetchPage>(std::move(fetch_page), page_size);
+}
+
 template <typename Iterator>
 std::ostream& operator<<(std::ostream& output, Page<Iterator> page) {
     for (auto it = page.begin(); it != page.end(); ++it) {
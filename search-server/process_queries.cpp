@@ -12,6 +12,20 @@ std::vector<std::vector<Document>> ProcessQueries(
     return result;
 }
 
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    QueryStatistics& statistics) {
+    std::vector<std::vector<Document>> result(queries.size());
+    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server, &statistics](const std::string& query) {
+        auto documents = search_server.FindTopDocuments(query);
+        statistics.Record(documents.size());
+        return documents;
+        });
+
+    return result;
+}
+
 std::list<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
@@ -4,6 +4,7 @@
 #include <execution>
 #include <utility>
 #include "search_server.h"
+#include "query_statistics.h"
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
@@ -11,4 +12,10 @@ std::vector<std::vector<Document>> ProcessQueries(
 
 std::list<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+// Число документов каждого запроса записывается в statistics из потоков обработки
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    QueryStatistics& statistics);
\ No newline at end of file
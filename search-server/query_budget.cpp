@@ -0,0 +1,38 @@
+#include "query_budget.h"
+
+#include <algorithm>
+
+QueryBudget QueryBudget::WithTimeout(std::chrono::nanoseconds timeout) {
+    QueryBudget budget;
+    budget.deadline = std::chrono::steady_clock::now() + timeout;
+    return budget;
+}
+
+QueryBudgetTracker::QueryBudgetTracker(const QueryBudget& budget)
+    : budget_(budget) {
+}
+
+uint64_t QueryBudgetTracker::Consume(uint64_t postings) {
+    const uint64_t visited = postings_visited_.fetch_add(postings, std::memory_order_relaxed) + postings;
+    if (exhausted_.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    if ((budget_.max_postings > 0 && visited >= budget_.max_postings)
+        || (budget_.deadline && std::chrono::steady_clock::now() >= *budget_.deadline)) {
+        exhausted_.store(true, std::memory_order_relaxed);
+        return 0;
+    }
+    return budget_.max_postings > 0 ? std::min(CHECK_INTERVAL, budget_.max_postings - visited) : CHECK_INTERVAL;
+}
+
+void QueryBudgetTracker::Record(uint64_t postings) {
+    postings_visited_.fetch_add(postings, std::memory_order_relaxed);
+}
+
+bool QueryBudgetTracker::IsExhausted() const {
+    return exhausted_.load(std::memory_order_relaxed);
+}
+
+uint64_t QueryBudgetTracker::GetPostingsVisited() const {
+    return postings_visited_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "document.h"
+
+// Ограничение на выполнение запроса. Пустой бюджет ничего не ограничивает
+struct QueryBudget {
+    std::optional<std::chrono::steady_clock::time_point> deadline;
+    uint64_t max_postings = 0; // Просмотренных записей обратного индекса, 0 - без ограничения
+
+    static QueryBudget WithTimeout(std::chrono::nanoseconds timeout);
+};
+
+struct PartialSearchResult {
+    std::vector<Document> documents;
+    bool partial = false;         // Бюджет исчерпан, выдача составлена по части записей индекса
+    uint64_t postings_visited = 0;
+};
+
+// Расход бюджета запроса, общий для потоков параллельного поиска. Цикл ранжирования проверяет бюджет
+// не на каждой записи, а порциями: время читается один раз на порцию
+class QueryBudgetTracker {
+public:
+    static const uint64_t CHECK_INTERVAL = 256;
+
+    explicit QueryBudgetTracker(const QueryBudget& budget);
+
+    // Списывает просмотренные записи и возвращает, сколько записей можно просмотреть до следующей проверки.
+    // 0 - бюджет исчерпан
+    uint64_t Consume(uint64_t postings);
+
+    // Списывает записи без проверки: остаток порции после завершения просмотра
+    void Record(uint64_t postings);
+
+    bool IsExhausted() const;
+
+    uint64_t GetPostingsVisited() const;
+
+private:
+    QueryBudget budget_;
+    std::atomic<uint64_t> postings_visited_{ 0 };
+    std::atomic<bool> exhausted_{ false };
+};
@@ -0,0 +1,36 @@
+#include "query_profile.h"
+
+using namespace std::literals;
+
+void QueryProfile::AddCounters(const QueryProfile& other) {
+    for (size_t i = 0; i < terms.size() && i < other.terms.size(); ++i) {
+        terms[i].postings_visited += other.terms[i].postings_visited;
+        terms[i].skipped_by_filter += other.terms[i].skipped_by_filter;
+        terms[i].skipped_by_minus += other.terms[i].skipped_by_minus;
+    }
+    accumulator_size += other.accumulator_size;
+    if (!other.index.empty()) {
+        index = other.index;
+    }
+}
+
+std::ostream& operator<<(std::ostream& output, const QueryProfile& profile) {
+    const auto to_microseconds = [](std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::micro>(duration).count();
+    };
+    output << "path = "sv << profile.execution_path << ", index = "sv << profile.index
+        << ", parse = "sv << to_microseconds(profile.parse_time) << " us"sv
+        << ", score = "sv << to_microseconds(profile.score_time) << " us"sv
+        << ", select = "sv << to_microseconds(profile.select_time) << " us"sv
+        << ", accumulator = "sv << profile.accumulator_size
+        << ", results = "sv << profile.result_count << '\n';
+    for (const TermProfile& term : profile.terms) {
+        output << (term.is_minus ? "-"sv : ""sv) << term.word
+            << ": postings = "sv << term.posting_length
+            << ", visited = "sv << term.postings_visited
+            << ", skipped by filter = "sv << term.skipped_by_filter
+            << ", skipped by minus = "sv << term.skipped_by_minus
+            << ", idf = "sv << term.idf << '\n';
+    }
+    return output;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Статистика одного слова запроса
+struct TermProfile {
+    std::string word;
+    bool is_minus = false;
+    size_t posting_length = 0;     // Число документов со словом
+    size_t postings_visited = 0;   // Просмотрено записей индекса
+    size_t skipped_by_filter = 0;  // Плюс-слово: документы, отброшенные фильтром или предикатом
+    size_t skipped_by_minus = 0;   // Минус-слово: документы, исключённые из выдачи
+    double idf = 0.0;              // Вес слова по политике ранжирования
+};
+
+// Профиль выполнения запроса. Собирается только по явной просьбе вызывающего,
+// без профиля поисковый сервер платит одной проверкой указателя на слово запроса
+struct QueryProfile {
+    std::vector<TermProfile> terms; // Сначала плюс-слова, затем минус-слова, в порядке разбора запроса
+    size_t accumulator_size = 0;    // Документов с ненулевой релевантностью до исключения минус-слов
+    size_t result_count = 0;
+    std::chrono::nanoseconds parse_time{ 0 };
+    std::chrono::nanoseconds score_time{ 0 };
+    std::chrono::nanoseconds select_time{ 0 };
+    std::string_view execution_path; // "seq" или "par"
+    std::string_view index;          // Индекс, по которому вычислялась выдача: "inverted", "impact", "forward" или "champion"
+
+    // Добавляет счётчики профиля диапазона документов, обработанного отдельным потоком
+    void AddCounters(const QueryProfile& other);
+};
+
+std::ostream& operator<<(std::ostream& output, const QueryProfile& profile);
@@ -0,0 +1,92 @@
+#include "query_statistics.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+std::atomic<size_t> next_statistics_shard_index{ 0 };
+
+size_t GetThreadShardIndex() {
+    thread_local const size_t shard_index = next_statistics_shard_index.fetch_add(1, std::memory_order_relaxed);
+    return shard_index;
+}
+
+}
+
+QueryStatistics::QueryStatistics(QueryStatisticsOptions options, Clock::time_point start)
+    : options_(options)
+    , start_(start) {
+    if (options_.bucket_width.count() <= 0 || options_.bucket_count == 0) {
+        throw std::invalid_argument("invalid query statistics options");
+    }
+    buckets_ = std::make_unique<Bucket[]>(options_.bucket_count);
+}
+
+int64_t QueryStatistics::GetEpoch(Clock::time_point time) const {
+    return std::max<int64_t>(0, (time - start_) / options_.bucket_width);
+}
+
+void QueryStatistics::Record(size_t result_count, Clock::time_point now) {
+    const int64_t epoch = GetEpoch(now);
+    Bucket& bucket = buckets_[static_cast<size_t>(epoch) % options_.bucket_count];
+    while (true) {
+        int64_t bucket_epoch = bucket.epoch.load(std::memory_order_acquire);
+        if (bucket_epoch == epoch) {
+            break;
+        }
+        if (bucket_epoch > epoch) {
+            return; // Корзина уже считает более поздний интервал: запись отстала на всё окно
+        }
+        if (bucket_epoch == RESETTING_EPOCH) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (bucket.epoch.compare_exchange_weak(bucket_epoch, RESETTING_EPOCH, std::memory_order_acquire)) {
+            for (Shard& shard : bucket.shards) {
+                shard.request_count.store(0, std::memory_order_relaxed);
+                for (auto& count : shard.result_counts) {
+                    count.store(0, std::memory_order_relaxed);
+                }
+            }
+            bucket.epoch.store(epoch, std::memory_order_release);
+            break;
+        }
+    }
+    Shard& shard = bucket.shards[GetThreadShardIndex() % SHARD_COUNT];
+    shard.request_count.fetch_add(1, std::memory_order_relaxed);
+    shard.result_counts[std::min(result_count, QUERY_RESULT_COUNT_BUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+QueryStatisticsReport QueryStatistics::GetReport(Clock::time_point now) const {
+    const int64_t epoch = GetEpoch(now);
+    const int64_t first_epoch = epoch - static_cast<int64_t>(options_.bucket_count) + 1;
+    QueryStatisticsReport report;
+    for (size_t i = 0; i < options_.bucket_count; ++i) {
+        const Bucket& bucket = buckets_[i];
+        const int64_t bucket_epoch = bucket.epoch.load(std::memory_order_acquire);
+        if (bucket_epoch < first_epoch || bucket_epoch > epoch) {
+            continue;
+        }
+        for (const Shard& shard : bucket.shards) {
+            report.request_count += shard.request_count.load(std::memory_order_relaxed);
+            for (size_t k = 0; k < QUERY_RESULT_COUNT_BUCKETS; ++k) {
+                report.result_counts[k] += shard.result_counts[k].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    report.no_result_count = report.result_counts[0];
+
+    // Окно охватывает полные корзины до текущей и прошедшую часть текущей, но не раньше начала работы
+    const auto window_start = start_ + options_.bucket_width * std::max<int64_t>(first_epoch, 0);
+    report.window = std::max(now - window_start, Clock::duration::zero());
+    const double seconds = std::chrono::duration<double>(report.window).count();
+    if (report.request_count > 0) {
+        report.no_result_rate = static_cast<double>(report.no_result_count) / report.request_count;
+    }
+    if (seconds > 0.0) {
+        report.qps = report.request_count / seconds;
+    }
+    return report;
+}
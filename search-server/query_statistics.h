@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "search_server.h"
+
+// Запросов с k найденными документами для k от 0 до MAX_RESULT_DOCUMENT_COUNT, последняя корзина - больше
+const size_t QUERY_RESULT_COUNT_BUCKETS = MAX_RESULT_DOCUMENT_COUNT + 2;
+
+struct QueryStatisticsOptions {
+    std::chrono::milliseconds bucket_width{ 1000 };
+    size_t bucket_count = 60; // Окно статистики - bucket_count корзин времени
+};
+
+struct QueryStatisticsReport {
+    std::chrono::nanoseconds window{ 0 }; // Фактическая длительность окна, меньше полной в начале работы
+    uint64_t request_count = 0;
+    uint64_t no_result_count = 0;
+    double no_result_rate = 0.0;
+    double qps = 0.0;
+    std::array<uint64_t, QUERY_RESULT_COUNT_BUCKETS> result_counts = {};
+};
+
+// Статистика запросов за скользящее окно по монотонным часам. Окно - кольцо корзин времени,
+// корзина хранит счётчики в шардах потоков. Запись стоит O(1) атомарных добавлений без блокировок:
+// первый записывающий в новую корзину захватывает её сравнением с обменом и обнуляет.
+// Запись потока, остановленного дольше чем на всё окно, может попасть в переиспользованную корзину,
+// поэтому статистика приблизительна на границе окна
+class QueryStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit QueryStatistics(QueryStatisticsOptions options = QueryStatisticsOptions(), Clock::time_point start = Clock::now());
+
+    void Record(size_t result_count, Clock::time_point now = Clock::now());
+
+    QueryStatisticsReport GetReport(Clock::time_point now = Clock::now()) const;
+
+private:
+    static const size_t SHARD_COUNT = 8;
+    static const int64_t EMPTY_EPOCH = -2;
+    static const int64_t RESETTING_EPOCH = -1;
+
+    // Шард занимает отдельные строки кэша, чтобы потоки не делили их при записи
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> request_count{ 0 };
+        std::array<std::atomic<uint64_t>, QUERY_RESULT_COUNT_BUCKETS> result_counts = {};
+    };
+
+    struct Bucket {
+        std::atomic<int64_t> epoch{ EMPTY_EPOCH }; // Номер интервала bucket_width от start_, который считает корзина
+        std::array<Shard, SHARD_COUNT> shards;
+    };
+
+    const QueryStatisticsOptions options_;
+    const Clock::time_point start_;
+    std::unique_ptr<Bucket[]> buckets_;
+
+    int64_t GetEpoch(Clock::time_point time) const;
+};
+
@@ -1,5 +1,9 @@
 #include "read_input_functions.h"
 
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
 
 std::string ReadLine() {
     std::string s;
@@ -12,4 +16,52 @@ int ReadLineWithNumber() {
     std::cin >> result;
     ReadLine();
     return result;
-}
\ No newline at end of file
+}
+
+DocumentStatus ParseDocumentStatus(std::string_view name) {
+    using namespace std::literals;
+    if (name == "ACTUAL"sv) {
+        return DocumentStatus::ACTUAL;
+    }
+    if (name == "IRRELEVANT"sv) {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (name == "BANNED"sv) {
+        return DocumentStatus::BANNED;
+    }
+    if (name == "REMOVED"sv) {
+        return DocumentStatus::REMOVED;
+    }
+    throw std::invalid_argument("unknown document status " + std::string(name));
+}
+
+int ReadDocuments(std::istream& input, SearchServer& search_server) {
+    int document_count = 0;
+    std::string line;
+    for (int line_number = 0; std::getline(input, line); ++line_number) {
+        std::vector<std::string_view> fields;
+        std::string_view rest = line;
+        for (size_t tab = rest.find('\t'); tab != rest.npos; tab = rest.find('\t')) {
+            fields.push_back(rest.substr(0, tab));
+            rest.remove_prefix(tab + 1);
+        }
+        fields.push_back(rest);
+
+        if (fields.size() == 1) {
+            search_server.AddDocument(line_number, fields[0], DocumentStatus::ACTUAL, {});
+        }
+        else if (fields.size() == 4) {
+            std::vector<int> ratings;
+            std::istringstream ratings_input{ std::string(fields[2]) };
+            for (int rating; ratings_input >> rating;) {
+                ratings.push_back(rating);
+            }
+            search_server.AddDocument(std::stoi(std::string(fields[0])), fields[3], ParseDocumentStatus(fields[1]), ratings);
+        }
+        else {
+            throw std::invalid_argument("invalid document line " + std::to_string(line_number + 1));
+        }
+        ++document_count;
+    }
+    return document_count;
+}
@@ -1,8 +1,18 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <iostream>
 
+#include "search_server.h"
+
 std::string ReadLine();
 
-int ReadLineWithNumber();
\ No newline at end of file
+int ReadLineWithNumber();
+
+// Статус по имени: ACTUAL, IRRELEVANT, BANNED или REMOVED
+DocumentStatus ParseDocumentStatus(std::string_view name);
+
+// Загружает документы по строке на документ: "id<TAB>STATUS<TAB>рейтинги через пробел<TAB>текст"
+// либо только текст, тогда ID - номер строки, статус ACTUAL, рейтингов нет. Возвращает число документов
+int ReadDocuments(std::istream& input, SearchServer& search_server);
@@ -1,27 +1,254 @@
 #include "remove_duplicates.h"
+#include "document_fingerprint.h"
 
-void RemoveDuplicates(SearchServer& search_server) {
-    std::map<std::set<std::string_view>, int> words_to_doc_id;
-    std::set<int> erase_doc_id;
-    for (const auto& document_id : search_server) {
-        if (erase_doc_id.count(document_id) != 0) {
-            continue;
+#include <array>
+#include <iterator>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+bool HaveSameWords(const SearchServer& search_server, int lhs_document_id, int rhs_document_id) {
+    const auto& lhs = search_server.GetWordFrequencies(lhs_document_id);
+    const auto& rhs = search_server.GetWordFrequencies(rhs_document_id);
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](const auto& lhs_word, const auto& rhs_word) {
+        return lhs_word.first == rhs_word.first;
+        });
+}
+
+const size_t MINHASH_BAND_COUNT = 16;
+const size_t MINHASH_ROWS_PER_BAND = 4;
+const size_t MAX_COMPONENT_LEADERS = 8;
+
+using BandKeys = std::array<uint64_t, MINHASH_BAND_COUNT>;
+
+// Сигнатура MinHash не хранится целиком: для каждой полосы сразу вычисляется ключ корзины
+template <typename WordFrequencies>
+BandKeys ComputeBandKeys(const WordFrequencies& word_frequencies) {
+    std::array<uint64_t, MINHASH_BAND_COUNT * MINHASH_ROWS_PER_BAND> signature;
+    signature.fill(std::numeric_limits<uint64_t>::max());
+    for (const auto& [word, _] : word_frequencies) {
+        const uint64_t word_hash = ComputeWordHash(word);
+        for (size_t i = 0; i < signature.size(); ++i) {
+            uint64_t hash = (word_hash ^ (0x9e3779b97f4a7c15ull * (i + 1))) * 0xff51afd7ed558ccdull;
+            hash ^= hash >> 32;
+            signature[i] = std::min(signature[i], hash);
+        }
+    }
+
+    BandKeys band_keys;
+    for (size_t band = 0; band < MINHASH_BAND_COUNT; ++band) {
+        uint64_t key = band;
+        for (size_t row = 0; row < MINHASH_ROWS_PER_BAND; ++row) {
+            key = (key ^ signature[band * MINHASH_ROWS_PER_BAND + row]) * 0x100000001b3ull;
+        }
+        band_keys[band] = key;
+    }
+    return band_keys;
+}
+
+std::vector<std::string_view> GetSortedWords(const SearchServer& search_server, int document_id) {
+    std::vector<std::string_view> words;
+    for (const auto& [word, _] : search_server.GetWordFrequencies(document_id)) {
+        words.push_back(word);
+    }
+    std::sort(words.begin(), words.end());
+    return words;
+}
+
+double ComputeJaccardSimilarity(const SearchServer& search_server, int lhs_document_id, int rhs_document_id) {
+    // Частоты слов идут в порядке ID слов, для слияния нужен общий порядок по строкам
+    const auto lhs = GetSortedWords(search_server, lhs_document_id);
+    const auto rhs = GetSortedWords(search_server, rhs_document_id);
+    size_t common_count = 0;
+    for (auto lhs_it = lhs.begin(), rhs_it = rhs.begin(); lhs_it != lhs.end() && rhs_it != rhs.end();) {
+        if (*lhs_it < *rhs_it) {
+            ++lhs_it;
+        }
+        else if (*rhs_it < *lhs_it) {
+            ++rhs_it;
+        }
+        else {
+            ++common_count;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    return static_cast<double>(common_count) / (lhs.size() + rhs.size() - common_count);
+}
+
+// Система непересекающихся множеств индексов документов. Корень множества - наименьший индекс в нём
+class DisjointSets {
+public:
+    explicit DisjointSets(size_t size)
+        : parents_(size) {
+        std::iota(parents_.begin(), parents_.end(), size_t{ 0 });
+    }
+
+    size_t Find(size_t index) {
+        while (parents_[index] != index) {
+            parents_[index] = parents_[parents_[index]];
+            index = parents_[index];
+        }
+        return index;
+    }
+
+    void Unite(size_t lhs, size_t rhs) {
+        lhs = Find(lhs);
+        rhs = Find(rhs);
+        if (lhs != rhs) {
+            parents_[std::max(lhs, rhs)] = std::min(lhs, rhs);
+        }
+    }
+
+private:
+    std::vector<size_t> parents_;
+};
+
+// Документы компоненты в порядке ID сравниваются с лидерами компоненты
+std::vector<NearDuplicate> FindComponentNearDuplicates(const SearchServer& search_server, const std::vector<int>& document_ids, double min_similarity) {
+    std::vector<NearDuplicate> near_duplicates;
+    std::vector<int> leader_ids;
+    uint64_t check_count = 0;
+    for (const int document_id : document_ids) {
+        bool matched = false;
+        for (const int leader_id : leader_ids) {
+            ++check_count;
+            const double similarity = ComputeJaccardSimilarity(search_server, leader_id, document_id);
+            if (similarity >= min_similarity) {
+                near_duplicates.push_back({ leader_id, document_id, similarity });
+                matched = true;
+                break;
+            }
         }
-        std::set<std::string_view> words;
-        for (const auto& [word, _] : search_server.GetWordFrequencies(document_id)) {
-            words.insert(word);
+        if (!matched && leader_ids.size() < MAX_COMPONENT_LEADERS) {
+            leader_ids.push_back(document_id);
         }
-        if (words_to_doc_id.count(words) != 0) {
-            erase_doc_id.insert(document_id);
+    }
+    ADD_TO_COUNTER(MetricCounter::NEAR_DUPLICATE_CHECKS, check_count);
+    return near_duplicates;
+}
+
+} // namespace
+
+void RemoveDuplicates(SearchServer& search_server) {
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    const SearchServer& const_search_server = search_server;
+
+    std::vector<DocumentFingerprint> fingerprints(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), fingerprints.begin(), [&const_search_server](const int document_id) {
+        return ComputeWordSetFingerprint(const_search_server.GetWordFrequencies(document_id));
+        });
+
+    // Документы с совпавшим отпечатком сравниваются точно, чтобы коллизия не удалила уникальный документ
+    std::unordered_map<DocumentFingerprint, std::vector<int>, DocumentFingerprintHasher> fingerprint_to_document_ids;
+    fingerprint_to_document_ids.reserve(document_ids.size());
+    std::vector<int> duplicate_ids;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const int document_id = document_ids[i];
+        auto& original_ids = fingerprint_to_document_ids[fingerprints[i]];
+        const bool is_duplicate = std::any_of(original_ids.begin(), original_ids.end(), [&const_search_server, document_id](const int original_id) {
+            return HaveSameWords(const_search_server, original_id, document_id);
+            });
+        if (is_duplicate) {
+            duplicate_ids.push_back(document_id);
         }
         else {
-            words_to_doc_id[words] = document_id;
+            original_ids.push_back(document_id);
+        }
+    }
+
+    for (const int id : duplicate_ids) {
+        std::cout << "Found duplicate document id "s << id << '\n';
+    }
+    std::cout.flush();
+    search_server.RemoveDocuments(duplicate_ids);
+}
+
+
+std::vector<NearDuplicate> FindNearDuplicates(const SearchServer& search_server, double min_similarity) {
+    std::vector<int> document_ids;
+    std::copy_if(search_server.begin(), search_server.end(), std::back_inserter(document_ids), [&search_server](const int document_id) {
+        return !search_server.GetWordFrequencies(document_id).empty();
+        });
+
+    std::vector<BandKeys> band_keys(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), band_keys.begin(), [&search_server](const int document_id) {
+        return ComputeBandKeys(search_server.GetWordFrequencies(document_id));
+        });
+
+    // Корзины собираются сортировкой пар (ключ полосы, индекс документа): документы одной корзины оказываются
+    // подряд, и каждый документ серии объединяется в компоненту с первым документом серии
+    std::vector<std::pair<uint64_t, size_t>> bucket_entries;
+    bucket_entries.reserve(document_ids.size() * MINHASH_BAND_COUNT);
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        for (size_t band = 0; band < MINHASH_BAND_COUNT; ++band) {
+            bucket_entries.emplace_back(band_keys[i][band], i);
+        }
+    }
+    std::sort(std::execution::par, bucket_entries.begin(), bucket_entries.end());
+
+    DisjointSets components(document_ids.size());
+    for (auto run_first = bucket_entries.begin(); run_first != bucket_entries.end();) {
+        const auto run_last = std::find_if(run_first, bucket_entries.end(), [run_first](const auto& entry) {
+            return entry.first != run_first->first;
+            });
+        for (auto it = std::next(run_first); it != run_last; ++it) {
+            components.Unite(run_first->second, it->second);
+        }
+        run_first = run_last;
+    }
+
+    // Документы компонент из нескольких документов в порядке ID, компоненты проверяются параллельно
+    std::vector<std::pair<size_t, size_t>> component_entries; // Корень компоненты и индекс документа
+    component_entries.reserve(document_ids.size());
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        component_entries.emplace_back(components.Find(i), i);
+    }
+    std::sort(std::execution::par, component_entries.begin(), component_entries.end());
+    std::vector<std::vector<int>> component_document_ids;
+    for (auto run_first = component_entries.begin(); run_first != component_entries.end();) {
+        const auto run_last = std::find_if(run_first, component_entries.end(), [run_first](const auto& entry) {
+            return entry.first != run_first->first;
+            });
+        if (std::next(run_first) != run_last) {
+            auto& ids = component_document_ids.emplace_back();
+            for (auto it = run_first; it != run_last; ++it) {
+                ids.push_back(document_ids[it->second]);
+            }
         }
-        
+        run_first = run_last;
+    }
+
+    std::vector<std::vector<NearDuplicate>> component_near_duplicates(component_document_ids.size());
+    std::transform(std::execution::par, component_document_ids.begin(), component_document_ids.end(), component_near_duplicates.begin(),
+        [&search_server, min_similarity](const std::vector<int>& ids) {
+            return FindComponentNearDuplicates(search_server, ids, min_similarity);
+        });
+    std::vector<NearDuplicate> near_duplicates;
+    for (const auto& component : component_near_duplicates) {
+        near_duplicates.insert(near_duplicates.end(), component.begin(), component.end());
     }
+    std::sort(near_duplicates.begin(), near_duplicates.end(), [](const NearDuplicate& lhs, const NearDuplicate& rhs) {
+        return std::pair(lhs.original_id, lhs.duplicate_id) < std::pair(rhs.original_id, rhs.duplicate_id);
+        });
+    return near_duplicates;
+}
 
-    for (auto& id : erase_doc_id) {
-        std::cout << "Found duplicate document id "s << id << std::endl;
-        search_server.RemoveDocument(id);
+void RemoveNearDuplicates(SearchServer& search_server, double min_similarity) {
+    auto near_duplicates = FindNearDuplicates(search_server, min_similarity);
+    std::sort(near_duplicates.begin(), near_duplicates.end(), [](const NearDuplicate& lhs, const NearDuplicate& rhs) {
+        return lhs.duplicate_id < rhs.duplicate_id;
+        });
+
+    // Оригинал всегда имеет меньший ID, поэтому к моменту проверки дубликата решение об оригинале уже принято
+    std::set<int> erase_doc_id;
+    for (const auto& near_duplicate : near_duplicates) {
+        if (erase_doc_id.count(near_duplicate.original_id) == 0 && erase_doc_id.insert(near_duplicate.duplicate_id).second) {
+            std::cout << "Found near duplicate document id "s << near_duplicate.duplicate_id
+                << " of "s << near_duplicate.original_id << '\n';
+        }
     }
-}
\ No newline at end of file
+    std::cout.flush();
+    search_server.RemoveDocuments(std::vector<int>(erase_doc_id.begin(), erase_doc_id.end()));
+}
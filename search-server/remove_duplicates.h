@@ -2,3 +2,18 @@
 #include "search_server.h"
 
 void RemoveDuplicates(SearchServer& search_server);
+
+struct NearDuplicate {
+    int original_id;
+    int duplicate_id;
+    double similarity; // Коэффициент Жаккара множеств слов
+};
+
+// Поиск почти совпадающих документов: кандидаты отбираются по сигнатурам MinHash с разбиением на полосы (LSH),
+// затем для кандидатов точно вычисляется коэффициент Жаккара. Документы, совпавшие хотя бы в одной корзине,
+// объединяются в компоненты. Внутри компоненты документ сравнивается с её лидерами, начиная с документа
+// с наименьшим ID, и сам становится лидером, если ни один не подошёл. Лидеров в компоненте не больше
+// восьми, поэтому сравнений линейное число даже для корзины из тысяч копий одной страницы
+std::vector<NearDuplicate> FindNearDuplicates(const SearchServer& search_server, double min_similarity = 0.8);
+
+void RemoveNearDuplicates(SearchServer& search_server, double min_similarity = 0.8);
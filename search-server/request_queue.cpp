@@ -28,6 +28,12 @@ RequestQueue::RequestQueue(const SearchServer& search_server)
 {
 }
 
+RequestQueue::RequestQueue(const SearchServer& search_server, QueryStatistics& statistics)
+    : RequestQueue(search_server)
+{
+    statistics_ = &statistics;
+}
+
 int RequestQueue::GetNoResultRequests() const {
     return no_results_requests_;
 }
@@ -39,6 +45,9 @@ RequestQueue::QueryResult::QueryResult(uint64_t time, int result)
 }
 
 void RequestQueue::AddRequests(int result) {
+    if (statistics_) {
+        statistics_->Record(static_cast<size_t>(result));
+    }
     ++current_time_;
     if (!requests_.empty() && current_time_ >= min_in_day_ + 1) {
         if (requests_.front().results == 0) {
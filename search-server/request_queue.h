@@ -1,10 +1,13 @@
 #pragma once
 #include "search_server.h"
+#include "query_statistics.h"
 #include <deque>
 
 class RequestQueue {
 public:
     explicit RequestQueue(const SearchServer& search_server);
+    // Кроме истории запросов, число документов каждого запроса записывается в statistics
+    RequestQueue(const SearchServer& search_server, QueryStatistics& statistics);
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
@@ -22,6 +25,7 @@ private:
     };
 
     const SearchServer& search_server_;
+    QueryStatistics* statistics_ = nullptr;
     std::deque<QueryResult> requests_;
     const static int min_in_day_ = 1440;
     int no_results_requests_;
@@ -0,0 +1,47 @@
+#pragma once
+#include <cmath>
+
+// Политики ранжирования для SearchServer::FindTopDocuments.
+// Политика подставляется параметром шаблона, поэтому расчёт релевантности встраивается в цикл по документам.
+//
+// ComputeTermWeight - вес слова по числу документов на сервере и числу документов со словом;
+// Score - вклад слова в релевантность документа по доле слова в документе (TF), весу слова
+// и, если USES_DOCUMENT_LENGTH, по длине документа и средней длине документов.
+
+// TF-IDF, используется по умолчанию
+struct TfIdfScoring {
+    static constexpr bool USES_DOCUMENT_LENGTH = false;
+    static constexpr bool USES_IMPACT_INDEX = false;
+
+    static double ComputeTermWeight(int document_count, int document_freq) {
+        return std::log(document_count * 1.0 / document_freq);
+    }
+
+    static double Score(double term_freq, double term_weight, double /*word_count*/, double /*average_word_count*/) {
+        return term_freq * term_weight;
+    }
+};
+
+// Okapi BM25 с длиной документа, сохранённой при AddDocument
+struct Bm25Scoring {
+    static constexpr bool USES_DOCUMENT_LENGTH = true;
+    static constexpr bool USES_IMPACT_INDEX = false;
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    static double ComputeTermWeight(int document_count, int document_freq) {
+        return std::log(1.0 + (document_count - document_freq + 0.5) / (document_freq + 0.5));
+    }
+
+    static double Score(double term_freq, double term_weight, double word_count, double average_word_count) {
+        const double word_freq = term_freq * word_count;
+        const double length_norm = K1 * (1.0 - B + B * word_count / average_word_count);
+        return term_weight * word_freq * (K1 + 1.0) / (word_freq + length_norm);
+    }
+};
+
+// TF-IDF по квантованным вкладам из SearchServer::BuildImpactIndex.
+// Пока индекс вкладов не построен или устарел после изменения документов, релевантность считается как TfIdfScoring
+struct QuantizedImpactScoring : TfIdfScoring {
+    static constexpr bool USES_IMPACT_INDEX = true;
+};
@@ -2,11 +2,12 @@
 
 using namespace std::literals;
 
-SearchServer::SearchServer(const std::string& stop_words) : SearchServer(std::string_view(stop_words))
+SearchServer::SearchServer(const std::string& stop_words, std::pmr::memory_resource* resource) : SearchServer(std::string_view(stop_words), resource)
 {
 }
 
-SearchServer::SearchServer(const std::string_view stop_words)
+SearchServer::SearchServer(const std::string_view stop_words, std::pmr::memory_resource* resource)
+    : memory_resource_(resource)
 {
     if (!IsValidWord(stop_words)) {
         throw std::invalid_argument("stop words contain invalid characters");
@@ -18,6 +19,7 @@ SearchServer::SearchServer(const std::string_view stop_words)
 
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
     const std::vector<int>& ratings) {
+    MEASURE_STAGE(MetricStage::ADD_DOCUMENT);
 
     if (!CheckID(document_id)) {
         throw std::invalid_argument("the document id already exists or is less than zero");
@@ -27,22 +29,101 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
         throw std::invalid_argument("the document contain invalid characters");
     }
     const auto words = SplitIntoWordsNoStop(document);
+    if (duplicate_policy_ != DuplicatePolicy::KEEP) {
+        if (const auto original_id = FindOriginalDocument(words)) {
+            if (duplicate_policy_ == DuplicatePolicy::REJECT) {
+                throw std::invalid_argument("the document duplicates an existing document");
+            }
+            alias_to_document_id_.emplace(document_id, *original_id);
+            document_id_to_aliases_[*original_id].push_back(document_id);
+            if (write_ahead_log_) {
+                write_ahead_log_->AppendAddDocument(document_id, document, status, ratings);
+            }
+            return;
+        }
+    }
+
+    impact_index_.Clear();
+    UnsealTermDictionary();
     const double inv_word_count = 1.0 / words.size();
+    std::vector<int> word_term_ids;
+    word_term_ids.reserve(words.size());
+    std::vector<int> frequent_term_ids; // Слова, с этим документом достигшие частоты CHAMPION_MIN_POSTINGS
     for (const auto word : words) {
-        auto it = word_of_documents_.emplace(std::string(word));
-        word_to_document_freqs_[*(it.first)][document_id] += inv_word_count;
-        doc_id_words_freq_[document_id][*(it.first)] += inv_word_count;
+        auto [it, inserted] = word_to_term_id_.emplace(word, static_cast<int>(term_id_to_word_.size()));
+        if (inserted) {
+            term_id_to_word_.push_back(it->first);
+        }
+        const auto [postings_it, new_word] = word_to_document_freqs_.try_emplace(it->first);
+        if (new_word) {
+            RegisterWord(it->second, it->first);
+        }
+        auto& id_freqs = postings_it->second;
+        const auto [freq_it, new_posting] = id_freqs.try_emplace(document_id, 0.0);
+        freq_it->second += inv_word_count;
+        if (new_posting && id_freqs.size() == CHAMPION_MIN_POSTINGS) {
+            frequent_term_ids.push_back(it->second);
+        }
+        word_term_ids.push_back(it->second);
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status});
+    std::sort(word_term_ids.begin(), word_term_ids.end());
+    std::vector<int> term_ids;
+    std::vector<double> term_freqs;
+    for (const int term_id : word_term_ids) {
+        if (term_ids.empty() || term_ids.back() != term_id) {
+            term_ids.push_back(term_id);
+            term_freqs.push_back(0.0);
+        }
+        term_freqs.back() += inv_word_count;
+    }
+
+    if (duplicate_policy_ != DuplicatePolicy::KEEP) {
+        fingerprint_to_document_ids_[ComputeDocumentFingerprint(term_ids)].push_back(document_id);
+    }
+    const int rating = ComputeAverageRating(ratings);
+    status_to_documents_[status].Insert(document_id);
+    rating_to_documents_[rating].Insert(document_id);
+    document_ratings_.Set(document_id, rating);
+    total_word_count_ += static_cast<int64_t>(words.size());
+    DocumentData document_data{ rating, status, static_cast<int>(words.size()), static_cast<int>(term_ids.size()), 0 };
+    AppendForwardIndex(document_data, term_ids, term_freqs);
+    documents_.emplace(document_id, document_data);
     added_doc_id_.insert(document_id);
+    for (size_t i = 0; i < term_ids.size(); ++i) {
+        AddToChampionLists(term_ids[i], document_id, term_freqs[i], document_data);
+        InvalidateTermBitmap(term_ids[i]);
+    }
+    for (const int term_id : frequent_term_ids) {
+        if (term_to_champions_.count(term_id) == 0) {
+            BuildChampionLists(term_id);
+        }
+    }
+    if (write_ahead_log_) {
+        write_ahead_log_->AppendAddDocument(document_id, document, status, ratings);
+    }
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
-    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+void SearchServer::SetDuplicatePolicy(DuplicatePolicy policy) {
+    duplicate_policy_ = policy;
+    fingerprint_to_document_ids_.clear();
+    if (policy != DuplicatePolicy::KEEP) {
+        for (const auto& [document_id, _] : documents_) {
+            fingerprint_to_document_ids_[ComputeDocumentFingerprint(GetDocumentTermIds(document_id))].push_back(document_id);
+        }
+    }
+}
+
+int SearchServer::GetOriginalDocumentId(int document_id) const {
+    const auto it = alias_to_document_id_.find(document_id);
+    if (it != alias_to_document_id_.end()) {
+        return it->second;
+    }
+    GetDocumentData(document_id);
+    return document_id;
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus document_status) const {
-    return FindTopDocuments(raw_query, [document_status](int document_id, DocumentStatus status, int rating) { return status == document_status; });
+void SearchServer::BuildImpactIndex(ImpactPrecision precision) {
+    impact_index_.Build(word_to_document_freqs_, GetDocumentCount(), precision);
 }
 
 int SearchServer::GetDocumentCount() const {
@@ -52,98 +133,278 @@ int SearchServer::GetDocumentCount() const {
 using DocQueryAndStatus = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
 DocQueryAndStatus SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    MEASURE_STAGE(MetricStage::MATCH_DOCUMENT);
+    const auto& document_data = GetDocumentData(document_id);
+    return { MatchDocumentTerms(ParseTermQuery(raw_query), document_id, document_data), document_data.status };
+}
 
-    if (added_doc_id_.count(document_id) == 0) {
-        throw std::out_of_range("the document id does not exist");
-    }
+DocQueryAndStatus SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const {
+    return MatchDocument(raw_query, document_id);
+}
 
-    const auto query = ParseQuery(raw_query, true);
-    std::vector<std::string_view> matched_words;
+DocQueryAndStatus SearchServer::MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query, int document_id) const {
+    // Слов в запросе слишком мало, чтобы распараллеливание по ним окупалось
+    return MatchDocument(raw_query, document_id);
+}
 
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [this, &document_id](const auto word) {
-        return doc_id_words_freq_.at(document_id).count(word) != 0;
-        })) {
-        return { matched_words, documents_.at(document_id).status };
-    }
+DocQueryAndStatus SearchServer::ProfileMatchDocument(const std::string_view raw_query, int document_id, QueryProfile& profile) const {
+    using Clock = std::chrono::steady_clock;
+    const auto& document_data = GetDocumentData(document_id);
+    profile = QueryProfile();
+    profile.execution_path = "seq";
+    profile.index = forward_index_enabled_ ? "forward" : "inverted";
 
-    for (const auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
-        }
+    auto stage_start = Clock::now();
+    const auto query = ParseQuery(raw_query);
+    const TermQuery term_query{ FindTermIds(query.plus_words), FindTermIds(query.minus_words) };
+    auto now = Clock::now();
+    profile.parse_time = now - stage_start;
+    StartQueryProfile<TfIdfScoring>(query, profile);
+
+    stage_start = Clock::now();
+    auto matched_words = MatchDocumentTerms(term_query, document_id, document_data);
+    now = Clock::now();
+    profile.score_time = now - stage_start;
+    profile.result_count = matched_words.size();
+    return { std::move(matched_words), document_data.status };
+}
+
+std::vector<DocQueryAndStatus> SearchServer::MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+std::vector<DocQueryAndStatus> SearchServer::MatchDocuments(const std::execution::sequenced_policy&, const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    const auto query = ParseTermQuery(raw_query);
+    std::vector<DocQueryAndStatus> result;
+    result.reserve(document_ids.size());
+    for (const int document_id : document_ids) {
+        const auto& document_data = GetDocumentData(document_id);
+        result.emplace_back(MatchDocumentTerms(query, document_id, document_data), document_data.status);
     }
+    return result;
+}
+
+std::vector<DocQueryAndStatus> SearchServer::MatchDocuments(const std::execution::parallel_policy&, const std::string_view raw_query, const std::vector<int>& document_ids) const {
+    const auto query = ParseTermQuery(raw_query);
+    std::vector<const DocumentData*> documents_data(document_ids.size());
+    std::transform(document_ids.begin(), document_ids.end(), documents_data.begin(), [this](const int document_id) {
+        return &GetDocumentData(document_id);
+        });
 
-    return { matched_words, documents_.at(document_id).status };
+    std::vector<DocQueryAndStatus> result(document_ids.size());
+    std::transform(std::execution::par, document_ids.begin(), document_ids.end(), documents_data.begin(), result.begin(), [this, &query](const int document_id, const DocumentData* document_data) {
+        return DocQueryAndStatus{ MatchDocumentTerms(query, document_id, *document_data), document_data->status };
+        });
+    return result;
 }
 
+std::pmr::set<int>::iterator SearchServer::begin() {
+    return added_doc_id_.begin();
+}
 
-DocQueryAndStatus SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const {
-    return MatchDocument(raw_query, document_id);
+std::pmr::set<int>::iterator SearchServer::end() {
+    return added_doc_id_.end();
 }
 
-DocQueryAndStatus SearchServer::MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query, int document_id) const {
-    if (added_doc_id_.count(document_id) == 0) {
-        throw std::out_of_range("the document id does not exist");
+std::pmr::set<int>::const_iterator SearchServer::begin() const {
+    return added_doc_id_.begin();
+}
+
+std::pmr::set<int>::const_iterator SearchServer::end() const {
+    return added_doc_id_.end();
+}
+
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    if (!forward_index_enabled_) {
+        throw std::logic_error("the forward index is disabled");
+    }
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return {};
     }
-    const auto query = ParseQuery(raw_query, false);
+    const size_t offset = it->second.forward_offset;
+    return { forward_term_ids_.data() + offset, forward_term_freqs_.data() + offset, static_cast<size_t>(it->second.unique_word_count), &term_id_to_word_ };
+}
 
-    DocQueryAndStatus result{ {}, documents_.at(document_id).status };
+void SearchServer::SetFuzzySearchEnabled(bool enabled, FuzzySearchOptions options) {
+    if (enabled && (options.max_edit_distance < 1 || options.max_edit_distance > 2)) {
+        throw std::invalid_argument("fuzzy search supports edit distance 1 or 2");
+    }
+    fuzzy_term_index_.reset();
+    if (!enabled) {
+        return;
+    }
+    fuzzy_search_options_ = options;
+    fuzzy_term_index_.emplace(options.max_edit_distance);
+    for (const auto& [word, _] : word_to_document_freqs_) {
+        fuzzy_term_index_->AddTerm(*FindTermId(word), word);
+    }
+}
 
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [this, &document_id](const auto word) {
-        return doc_id_words_freq_.at(document_id).count(word) != 0;
-        })) {
-        return result;
+void SearchServer::SealTermDictionary() {
+    if (!term_dictionary_.Empty()) {
+        return;
+    }
+    size_t total_length = 0;
+    for (const auto& [word, _] : word_to_document_freqs_) {
+        total_length += word.size();
+    }
+    // Буфер не перераспределяется после reserve, поэтому ссылки на тексты слов в нём остаются верными
+    sealed_words_.clear();
+    sealed_words_.reserve(total_length);
+    std::vector<TermDictionary::Entry> entries;
+    entries.reserve(word_to_document_freqs_.size());
+    std::vector<std::pair<int, std::string_view>> words;
+    words.reserve(word_to_document_freqs_.size());
+    for (const auto& [word, id_freqs] : word_to_document_freqs_) {
+        const std::string_view sealed_word(sealed_words_.data() + sealed_words_.size(), word.size());
+        sealed_words_.append(word);
+        const int term_id = word_to_term_id_.find(word)->second;
+        entries.push_back({ sealed_word, term_id, static_cast<uint32_t>(id_freqs.size()) });
+        words.emplace_back(term_id, sealed_word);
     }
+    term_dictionary_.Build(entries);
+    // Слова, исчезнувшие из индекса, в словарь не попадают: их ID больше не встречаются в индексе
+    std::fill(term_id_to_word_.begin(), term_id_to_word_.end(), std::string_view());
+    RebindWords(words);
+    word_to_term_id_.clear();
+}
 
-    std::get<0>(result).resize(query.plus_words.size());
+bool SearchServer::IsTermDictionarySealed() const {
+    return !term_dictionary_.Empty();
+}
 
-    auto it_end = copy_if(std::execution::par, query.plus_words.begin(), query.plus_words.end(), std::get<0>(result).begin(), [this, &document_id](const auto word) {
-            return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id);
-        });
+void SearchServer::UnsealTermDictionary() {
+    if (term_dictionary_.Empty()) {
+        return;
+    }
+    // Словарь перечисляет слова в том же порядке, что и обратный индекс
+    const auto term_ids = term_dictionary_.FindPrefix({});
+    std::vector<std::pair<int, std::string_view>> words;
+    words.reserve(term_ids.size());
+    auto term_id_it = term_ids.begin();
+    for (const auto& [word, _] : word_to_document_freqs_) {
+        const auto it = word_to_term_id_.emplace_hint(word_to_term_id_.end(), word, *term_id_it++);
+        words.emplace_back(it->second, it->first);
+    }
+    RebindWords(words);
+    term_dictionary_.Clear();
+    sealed_words_.clear();
+    sealed_words_.shrink_to_fit();
+}
 
-    std::sort(std::get<0>(result).begin(), it_end);
-    it_end = std::unique(std::get<0>(result).begin(), it_end);
-    std::get<0>(result).erase(it_end, std::get<0>(result).end());
-    return result;
+void SearchServer::RebindWords(const std::vector<std::pair<int, std::string_view>>& words) {
+    auto word_it = word_to_document_freqs_.begin();
+    for (const auto& [term_id, word] : words) {
+        term_id_to_word_[term_id] = word;
+        // Порядок слов не меняется, поэтому узел возвращается на прежнее место
+        const auto next_it = std::next(word_it);
+        auto node = word_to_document_freqs_.extract(word_it);
+        node.key() = word;
+        word_to_document_freqs_.insert(next_it, std::move(node));
+        word_it = next_it;
+    }
+    if (!impact_index_.Empty()) {
+        impact_index_.Build(word_to_document_freqs_, GetDocumentCount(), impact_index_.GetPrecision());
+    }
 }
 
+std::optional<int> SearchServer::FindTermId(std::string_view word) const {
+    if (!term_dictionary_.Empty()) {
+        return term_dictionary_.Find(word);
+    }
+    const auto it = word_to_term_id_.find(word);
+    if (it == word_to_term_id_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
 
-std::set<int>::iterator SearchServer::begin() {
-    return added_doc_id_.begin();
+void SearchServer::RegisterWord(int term_id, std::string_view word) {
+    if (fuzzy_term_index_) {
+        fuzzy_term_index_->AddTerm(term_id, word);
+    }
 }
 
-std::set<int>::iterator SearchServer::end() {
-    return added_doc_id_.end();
+void SearchServer::ForgetWord(int term_id, std::string_view word) {
+    if (fuzzy_term_index_) {
+        fuzzy_term_index_->RemoveTerm(term_id, word);
+    }
+}
+
+void SearchServer::SetWriteAheadLog(WriteAheadLog* write_ahead_log) {
+    write_ahead_log_ = write_ahead_log;
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const std::map<std::string_view, double> empty_map_;
+void SearchServer::SetForwardIndexEnabled(bool enabled) {
+    if (enabled == forward_index_enabled_) {
+        return;
+    }
+    forward_term_ids_.clear();
+    forward_term_ids_.shrink_to_fit();
+    forward_term_freqs_.clear();
+    forward_term_freqs_.shrink_to_fit();
+    forward_index_garbage_ = 0;
+    forward_index_enabled_ = enabled;
+    if (!enabled) {
+        return;
+    }
 
-    return (doc_id_words_freq_.count(document_id) == 0) ? empty_map_ : doc_id_words_freq_.at(document_id);
+    std::map<int, std::vector<std::pair<int, double>>> document_to_term_freqs;
+    for (const auto& [word, id_freqs] : word_to_document_freqs_) {
+        const int term_id = *FindTermId(word);
+        for (const auto& [document_id, term_freq] : id_freqs) {
+            document_to_term_freqs[document_id].emplace_back(term_id, term_freq);
+        }
+    }
+    for (auto& [document_id, document_data] : documents_) {
+        auto& term_freqs = document_to_term_freqs[document_id];
+        std::sort(term_freqs.begin(), term_freqs.end());
+        document_data.forward_offset = forward_term_ids_.size();
+        for (const auto& [term_id, term_freq] : term_freqs) {
+            forward_term_ids_.push_back(term_id);
+            forward_term_freqs_.push_back(term_freq);
+        }
+    }
 }
 
 void SearchServer::RemoveDocument(int document_id) {
+    MEASURE_STAGE(MetricStage::REMOVE_DOCUMENT);
+    if (RemoveAlias(document_id)) {
+        if (write_ahead_log_) {
+            write_ahead_log_->AppendRemoveDocument(document_id);
+        }
+        return;
+    }
     auto it = added_doc_id_.find(document_id);
     if (it == end()) {
         throw std::out_of_range("invalid document ID");
     }
+    const auto term_ids = GetDocumentTermIds(document_id);
+    ForgetDocumentFingerprint(document_id, term_ids);
+    EraseDocumentAttributes(document_id);
+    impact_index_.Clear();
+    UnsealTermDictionary();
     added_doc_id_.erase(it);
-    for (auto& [word, id_relev] : word_to_document_freqs_) {
-        id_relev.erase(document_id);
-    }
 
-    for (auto& [word, _] : doc_id_words_freq_.at(document_id)) {
-        auto iter = word_of_documents_.find(word);
-        if ((*iter).empty()) {
-            word_to_document_freqs_.erase(word);
-            word_of_documents_.erase(iter);
+    const std::vector<int> removed_ids{ document_id };
+    for (const int term_id : term_ids) {
+        const auto word_it = word_to_document_freqs_.find(term_id_to_word_[term_id]);
+        word_it->second.erase(document_id);
+        if (word_it->second.empty()) {
+            ForgetWord(term_id, word_it->first);
+            word_to_document_freqs_.erase(word_it);
         }
+        RemoveFromChampionLists(term_id, removed_ids);
+        InvalidateTermBitmap(term_id);
     }
 
+    const DocumentData document_data = documents_.at(document_id);
     documents_.erase(document_id);
-    doc_id_words_freq_.erase(document_id);
+    ReleaseForwardIndex(document_data);
+    if (write_ahead_log_) {
+        write_ahead_log_->AppendRemoveDocument(document_id);
+    }
 }
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id) {
@@ -151,32 +412,109 @@ void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int d
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
+    MEASURE_STAGE(MetricStage::REMOVE_DOCUMENT);
+    if (RemoveAlias(document_id)) {
+        if (write_ahead_log_) {
+            write_ahead_log_->AppendRemoveDocument(document_id);
+        }
+        return;
+    }
     const auto it = added_doc_id_.find(document_id);
     if (it != end()) {
+        const auto term_ids = GetDocumentTermIds(document_id);
+        ForgetDocumentFingerprint(document_id, term_ids);
+        EraseDocumentAttributes(document_id);
+        impact_index_.Clear();
+        UnsealTermDictionary();
 
-        std::map<std::string_view, double> words_relev = doc_id_words_freq_.at(document_id);
-        std::vector<std::string_view> words(words_relev.size());
-
-        std::transform(std::execution::par, words_relev.begin(), words_relev.end(), words.begin(), [](const auto& word_relev) {
-            return word_relev.first;
-        });
-
-        std::for_each(std::execution::par, words.begin(), words.end(), [this, &document_id](const auto& word) {
-            word_to_document_freqs_.at(word).erase(document_id);
-        });
-
+        std::for_each(std::execution::par, term_ids.begin(), term_ids.end(), [this, &document_id](const int term_id) {
+            word_to_document_freqs_.at(term_id_to_word_[term_id]).erase(document_id);
+            });
 
-        std::for_each(words.begin(), words.end(), [this, &document_id](const auto& word) {
-            auto iter = word_of_documents_.find(word);
-            if ((*iter).empty()) {
-                word_to_document_freqs_.erase(word);
-                word_of_documents_.erase(iter);
+        const std::vector<int> removed_ids{ document_id };
+        std::for_each(term_ids.begin(), term_ids.end(), [this, &removed_ids](const int term_id) {
+            const auto word_it = word_to_document_freqs_.find(term_id_to_word_[term_id]);
+            if (word_it->second.empty()) {
+                ForgetWord(term_id, word_it->first);
+                word_to_document_freqs_.erase(word_it);
             }
+            RemoveFromChampionLists(term_id, removed_ids);
+            InvalidateTermBitmap(term_id);
             });
 
         added_doc_id_.erase(it);
+        const DocumentData document_data = documents_.at(document_id);
+        documents_.erase(document_id);
+        ReleaseForwardIndex(document_data);
+        if (write_ahead_log_) {
+            write_ahead_log_->AppendRemoveDocument(document_id);
+        }
+    }
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& ids) {
+    MEASURE_STAGE(MetricStage::REMOVE_DOCUMENT);
+    for (const int document_id : ids) {
+        if (added_doc_id_.count(document_id) == 0 && alias_to_document_id_.count(document_id) == 0) {
+            throw std::out_of_range("invalid document ID");
+        }
+    }
+
+    std::vector<int> document_ids;
+    for (const int document_id : ids) {
+        if (!RemoveAlias(document_id) && added_doc_id_.count(document_id) != 0) {
+            document_ids.push_back(document_id);
+        }
+    }
+    std::sort(document_ids.begin(), document_ids.end());
+    document_ids.erase(std::unique(document_ids.begin(), document_ids.end()), document_ids.end());
+
+    if (!document_ids.empty()) {
+        impact_index_.Clear();
+        UnsealTermDictionary();
+    }
+
+    std::map<int, std::vector<int>> term_to_removed_ids;
+    for (const int document_id : document_ids) {
+        const auto term_ids = GetDocumentTermIds(document_id);
+        ForgetDocumentFingerprint(document_id, term_ids);
+        EraseDocumentAttributes(document_id);
+        for (const int term_id : term_ids) {
+            term_to_removed_ids[term_id].push_back(document_id);
+        }
+    }
+
+    std::vector<std::pair<std::pmr::map<int, double>*, const std::vector<int>*>> postings;
+    postings.reserve(term_to_removed_ids.size());
+    for (const auto& [term_id, removed_ids] : term_to_removed_ids) {
+        postings.emplace_back(&word_to_document_freqs_.at(term_id_to_word_[term_id]), &removed_ids);
+    }
+    std::for_each(std::execution::par, postings.begin(), postings.end(), [](const auto& posting) {
+        for (const int document_id : *posting.second) {
+            posting.first->erase(document_id);
+        }
+        });
+
+    for (const auto& [term_id, removed_ids] : term_to_removed_ids) {
+        const auto word_it = word_to_document_freqs_.find(term_id_to_word_[term_id]);
+        if (word_it->second.empty()) {
+            ForgetWord(term_id, word_it->first);
+            word_to_document_freqs_.erase(word_it);
+        }
+        RemoveFromChampionLists(term_id, removed_ids);
+        InvalidateTermBitmap(term_id);
+    }
+
+    for (const int document_id : document_ids) {
+        added_doc_id_.erase(document_id);
+        const DocumentData document_data = documents_.at(document_id);
         documents_.erase(document_id);
-        doc_id_words_freq_.erase(document_id);
+        ReleaseForwardIndex(document_data);
+    }
+    if (write_ahead_log_) {
+        for (const int document_id : ids) {
+            write_ahead_log_->AppendRemoveDocument(document_id);
+        }
     }
 }
 
@@ -213,6 +551,7 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
 
 
 SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool sort) const {
+    MEASURE_STAGE(MetricStage::PARSE_QUERY);
     Query query;
     if (!IsValidWord(text)) {
         throw std::invalid_argument("query words contain invalid characters");
@@ -238,9 +577,639 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool s
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
+bool SearchServer::IsBetterChampion(const Champion& lhs, const Champion& rhs) {
+    if (lhs.term_freq != rhs.term_freq) {
+        return lhs.term_freq > rhs.term_freq;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.document_id < rhs.document_id;
+}
+
+void SearchServer::BuildChampionLists(int term_id) {
+    auto& status_to_champions = term_to_champions_[term_id];
+    status_to_champions.clear();
+    for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(term_id_to_word_[term_id])) {
+        const DocumentData& document_data = documents_.at(document_id);
+        status_to_champions[document_data.status].champions.push_back({ document_id, term_freq, document_data.rating });
+    }
+    for (auto& [_, list] : status_to_champions) {
+        auto& champions = list.champions;
+        list.complete = champions.size() <= CHAMPION_LIST_SIZE;
+        if (list.complete) {
+            std::sort(champions.begin(), champions.end(), IsBetterChampion);
+        }
+        else {
+            std::partial_sort(champions.begin(), champions.begin() + CHAMPION_LIST_SIZE, champions.end(), IsBetterChampion);
+            champions.resize(CHAMPION_LIST_SIZE);
+            champions.shrink_to_fit();
+        }
+    }
+}
+
+void SearchServer::AddToChampionLists(int term_id, int document_id, double term_freq, const DocumentData& document_data) {
+    const auto it = term_to_champions_.find(term_id);
+    if (it == term_to_champions_.end()) {
+        return;
+    }
+    ChampionList& list = it->second[document_data.status];
+    auto& champions = list.champions;
+    const Champion champion{ document_id, term_freq, document_data.rating };
+    const auto position = std::lower_bound(champions.begin(), champions.end(), champion, IsBetterChampion);
+    // Неполный список хранит лучшие документы, документ хуже последнего в нём может уступать неизвестным
+    if (position == champions.end() && !list.complete) {
+        return;
+    }
+    champions.insert(position, champion);
+    if (champions.size() > CHAMPION_LIST_SIZE) {
+        champions.pop_back();
+        list.complete = false;
+    }
+}
+
+void SearchServer::RemoveFromChampionLists(int term_id, const std::vector<int>& document_ids) {
+    const auto it = term_to_champions_.find(term_id);
+    if (it == term_to_champions_.end()) {
+        return;
+    }
+    const auto word_it = word_to_document_freqs_.find(term_id_to_word_[term_id]);
+    if (word_it == word_to_document_freqs_.end() || word_it->second.size() < CHAMPION_MIN_POSTINGS / 2) {
+        term_to_champions_.erase(it);
+        return;
+    }
+    bool rebuild = false;
+    for (const int document_id : document_ids) {
+        const auto list_it = it->second.find(documents_.at(document_id).status);
+        if (list_it == it->second.end()) {
+            continue;
+        }
+        ChampionList& list = list_it->second;
+        auto& champions = list.champions;
+        const auto position = std::find_if(champions.begin(), champions.end(), [document_id](const Champion& champion) {
+            return champion.document_id == document_id;
+            });
+        if (position != champions.end()) {
+            champions.erase(position);
+            // Оставшиеся документы по-прежнему лучшие, но без пересборки список неполного слова иссякнет
+            rebuild = rebuild || (!list.complete && champions.size() < CHAMPION_LIST_SIZE / 2);
+        }
+    }
+    if (rebuild) {
+        BuildChampionLists(term_id);
+    }
+}
+
+std::optional<std::vector<Document>> SearchServer::FindChampionDocuments(const Query& query, const DocumentFilter& document_filter) const {
+    if (term_to_champions_.empty() || document_filter.statuses.size() != 1 || document_filter.HasRatingRange()) {
+        return std::nullopt;
+    }
+    if (query.plus_words.size() != 1 || !query.minus_words.empty() || !query.plus_word_weights.empty()) {
+        return std::nullopt;
+    }
+    const auto term_id = FindTermId(query.plus_words.front());
+    if (!term_id) {
+        return std::nullopt;
+    }
+    const auto champions_it = term_to_champions_.find(*term_id);
+    if (champions_it == term_to_champions_.end()) {
+        return std::nullopt;
+    }
+    std::vector<Document> documents;
+    const auto list_it = champions_it->second.find(document_filter.statuses.front());
+    if (list_it == champions_it->second.end()) {
+        ADD_TO_COUNTER(MetricCounter::CHAMPION_LIST_HITS, 1);
+        return documents;
+    }
+    const ChampionList& list = list_it->second;
+    const int posting_length = static_cast<int>(word_to_document_freqs_.at(query.plus_words.front()).size());
+    const double term_weight = TfIdfScoring::ComputeTermWeight(GetDocumentCount(), posting_length);
+    documents.reserve(list.champions.size());
+    for (const Champion& champion : list.champions) {
+        documents.push_back({ champion.document_id, TfIdfScoring::Score(champion.term_freq, term_weight, 0.0, 0.0), champion.rating });
+    }
+    SelectTopDocuments(documents, MAX_RESULT_DOCUMENT_COUNT);
+    // Документ вне неполного списка не лучше последнего в нём, но при близкой релевантности обошёл бы выданный по рейтингу
+    if (!list.complete) {
+        const double boundary_relevance = TfIdfScoring::Score(list.champions.back().term_freq, term_weight, 0.0, 0.0);
+        if (documents.size() < MAX_RESULT_DOCUMENT_COUNT || documents.back().relevance - boundary_relevance < ERROR_RATE) {
+            return std::nullopt;
+        }
+    }
+    ADD_TO_COUNTER(MetricCounter::CHAMPION_LIST_HITS, 1);
+    return documents;
+}
+
+bool SearchServer::PostingCursor::Seek(int document_id) {
+    const int LINEAR_SEEK_STEPS = 8;
+    for (int step = 0; step < LINEAR_SEEK_STEPS; ++step) {
+        if (it == id_freqs->end() || it->first >= document_id) {
+            return it != id_freqs->end();
+        }
+        ++it;
+        ++postings_visited;
+    }
+    it = id_freqs->lower_bound(document_id);
+    ++postings_visited;
+    return it != id_freqs->end();
+}
+
+void SearchServer::ExpandPrefixWords(Query& query) const {
+    const auto is_prefix = [](std::string_view word) {
+        return word.size() > 1 && word.back() == '*';
+    };
+    if (std::none_of(query.plus_words.begin(), query.plus_words.end(), is_prefix)) {
+        return;
+    }
+    std::vector<std::string_view> plus_words;
+    for (const std::string_view word : query.plus_words) {
+        if (!is_prefix(word)) {
+            plus_words.push_back(word);
+            continue;
+        }
+        const std::string_view prefix = word.substr(0, word.size() - 1);
+        if (!term_dictionary_.Empty()) {
+            for (const int term_id : term_dictionary_.FindTopPrefix(prefix, MAX_PREFIX_EXPANSIONS)) {
+                plus_words.push_back(term_id_to_word_[term_id]);
+            }
+            continue;
+        }
+        // Без словаря перебираются все слова с префиксом, но в куче остаются только MAX_PREFIX_EXPANSIONS лучших:
+        // чаще, а при равной частоте раньше по порядку слов. Худшее из отобранных - на вершине кучи
+        std::vector<std::pair<size_t, std::string_view>> completions; // Число документов со словом и слово
+        completions.reserve(MAX_PREFIX_EXPANSIONS);
+        const auto is_better = [](const auto& lhs, const auto& rhs) {
+            return lhs.first != rhs.first ? lhs.first > rhs.first : lhs.second < rhs.second;
+        };
+        for (auto it = word_to_document_freqs_.lower_bound(prefix); it != word_to_document_freqs_.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+            const std::pair<size_t, std::string_view> completion(it->second.size(), it->first);
+            if (completions.size() < MAX_PREFIX_EXPANSIONS) {
+                completions.push_back(completion);
+                std::push_heap(completions.begin(), completions.end(), is_better);
+            }
+            else if (is_better(completion, completions.front())) {
+                std::pop_heap(completions.begin(), completions.end(), is_better);
+                completions.back() = completion;
+                std::push_heap(completions.begin(), completions.end(), is_better);
+            }
+        }
+        for (const auto& [_, completion] : completions) {
+            plus_words.push_back(completion);
+        }
+    }
+    std::sort(plus_words.begin(), plus_words.end());
+    plus_words.erase(std::unique(plus_words.begin(), plus_words.end()), plus_words.end());
+    query.plus_words = std::move(plus_words);
+}
+
+void SearchServer::ExpandFuzzyWords(Query& query) const {
+    const size_t word_count = query.plus_words.size();
+    for (size_t word_index = 0; word_index < word_count; ++word_index) {
+        const std::string_view word = query.plus_words[word_index];
+        if (word_to_document_freqs_.count(word) > 0) {
+            continue;
+        }
+        // Замены по возрастанию расстояния, при равном расстоянии - по убыванию частоты слова
+        std::vector<std::tuple<int, int, int>> suggestions;
+        for (const auto& [term_id, distance] : fuzzy_term_index_->FindSuggestions(word, term_id_to_word_)) {
+            const int posting_length = static_cast<int>(word_to_document_freqs_.at(term_id_to_word_[term_id]).size());
+            suggestions.emplace_back(distance, -posting_length, term_id);
+        }
+        std::sort(suggestions.begin(), suggestions.end());
+        if (suggestions.size() > fuzzy_search_options_.max_suggestions) {
+            suggestions.resize(fuzzy_search_options_.max_suggestions);
+        }
+        for (const auto& [distance, _, term_id] : suggestions) {
+            const std::string_view suggestion = term_id_to_word_[term_id];
+            if (std::find(query.plus_words.begin(), query.plus_words.end(), suggestion) != query.plus_words.end()) {
+                continue;
+            }
+            if (query.plus_word_weights.empty()) {
+                query.plus_word_weights.assign(query.plus_words.size(), 1.0);
+            }
+            query.plus_words.push_back(suggestion);
+            query.plus_word_weights.push_back(std::pow(fuzzy_search_options_.distance_penalty, distance));
+        }
+    }
+}
+
+std::vector<SearchServer::DocumentIdRange> SearchServer::SplitDocumentIdRanges() const {
+    if (added_doc_id_.empty()) {
+        return { ALL_DOCUMENT_IDS };
+    }
+    // Диапазонов больше, чем потоков, чтобы выровнять нагрузку при неравномерном распределении ID
+    const int64_t first_id = *added_doc_id_.begin();
+    const int64_t last_id = *added_doc_id_.rbegin();
+    const int64_t range_count = std::min<int64_t>(std::max(1u, std::thread::hardware_concurrency()) * 4, last_id - first_id + 1);
+    const int64_t range_width = (last_id - first_id + range_count) / range_count;
+
+    std::vector<DocumentIdRange> ranges;
+    ranges.reserve(range_count);
+    for (int64_t first = first_id; first <= last_id; first += range_width) {
+        const int64_t last = std::min(first + range_width - 1, last_id);
+        ranges.push_back({ static_cast<int>(first), static_cast<int>(last) });
+    }
+    return ranges;
+}
+
+bool SearchServer::CompareDocuments(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < ERROR_RATE) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+void SearchServer::SelectTopDocuments(std::vector<Document>& documents, size_t count) {
+    if (documents.size() > count) {
+        std::partial_sort(documents.begin(), documents.begin() + count, documents.end(), CompareDocuments);
+        documents.resize(count);
+    }
+    else {
+        std::sort(documents.begin(), documents.end(), CompareDocuments);
+    }
+}
+
+void SearchServer::SelectPage(std::vector<Document>& documents, const SearchCursor& cursor, size_t page_size) {
+    if (!cursor.IsStart()) {
+        documents.erase(std::remove_if(documents.begin(), documents.end(), [&cursor](const Document& document) {
+            return !cursor.Precedes(document);
+            }), documents.end());
+    }
+    if (documents.size() > page_size) {
+        std::nth_element(documents.begin(), documents.begin() + page_size, documents.end(), ComesBefore);
+        documents.resize(page_size);
+    }
+    std::sort(documents.begin(), documents.end(), ComesBefore);
+}
+
+SearchServer::TermQuery SearchServer::ParseTermQuery(const std::string_view text) const {
+    const auto query = ParseQuery(text, false);
+    return { FindTermIds(query.plus_words), FindTermIds(query.minus_words) };
+}
+
+std::vector<int> SearchServer::FindTermIds(const std::vector<std::string_view>& words) const {
+    std::vector<int> term_ids;
+    term_ids.reserve(words.size());
+    for (const auto word : words) {
+        if (const auto term_id = FindTermId(word)) {
+            term_ids.push_back(*term_id);
+        }
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    return term_ids;
+}
+
+namespace {
+
+// Пересечение отсортированных массивов: короткий массив ищется в длинном бинарным поиском,
+// массивы сопоставимой длины сливаются линейно
+template <typename OutputIt>
+OutputIt IntersectSortedTermIds(const std::vector<int>& query_term_ids, const int* document_first, const int* document_last, OutputIt output) {
+    if (query_term_ids.size() * 8 < static_cast<size_t>(document_last - document_first)) {
+        for (const int term_id : query_term_ids) {
+            document_first = std::lower_bound(document_first, document_last, term_id);
+            if (document_first == document_last) {
+                break;
+            }
+            if (*document_first == term_id) {
+                *output++ = term_id;
+            }
+        }
+        return output;
+    }
+    return std::set_intersection(query_term_ids.begin(), query_term_ids.end(), document_first, document_last, output);
+}
+
+} // namespace
+
+std::vector<std::string_view> SearchServer::MatchDocumentTerms(const TermQuery& query, int document_id, const DocumentData& document_data) const {
+    const auto contains_term = [this, document_id, &document_data](const int term_id) {
+        return DocumentContainsTerm(document_id, document_data, term_id);
+    };
+    std::vector<std::string_view> matched_words;
+    if (std::any_of(query.minus_term_ids.begin(), query.minus_term_ids.end(), contains_term)) {
+        return matched_words;
+    }
+
+    std::vector<int> matched_term_ids;
+    if (forward_index_enabled_) {
+        const int* document_term_ids = forward_term_ids_.data() + document_data.forward_offset;
+        IntersectSortedTermIds(query.plus_term_ids, document_term_ids, document_term_ids + document_data.unique_word_count, std::back_inserter(matched_term_ids));
+    }
+    else {
+        std::copy_if(query.plus_term_ids.begin(), query.plus_term_ids.end(), std::back_inserter(matched_term_ids), contains_term);
+    }
+    matched_words.reserve(matched_term_ids.size());
+    for (const int term_id : matched_term_ids) {
+        matched_words.push_back(term_id_to_word_[term_id]);
+    }
+    std::sort(matched_words.begin(), matched_words.end());
+    return matched_words;
+}
+
+const SearchServer::DocumentData& SearchServer::GetDocumentData(int document_id) const {
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        throw std::out_of_range("the document id does not exist");
+    }
+    return it->second;
+}
+
+std::vector<int> SearchServer::GetDocumentTermIds(int document_id) const {
+    const auto& document_data = documents_.at(document_id);
+    if (forward_index_enabled_) {
+        const auto first = forward_term_ids_.begin() + document_data.forward_offset;
+        return { first, first + document_data.unique_word_count };
+    }
+
+    std::vector<int> term_ids;
+    term_ids.reserve(document_data.unique_word_count);
+    for (const auto& [word, id_freqs] : word_to_document_freqs_) {
+        if (id_freqs.count(document_id) != 0) {
+            term_ids.push_back(*FindTermId(word));
+        }
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    return term_ids;
+}
+
+bool SearchServer::DocumentContainsTerm(int document_id, const DocumentData& document_data, int term_id) const {
+    if (forward_index_enabled_) {
+        const auto first = forward_term_ids_.begin() + document_data.forward_offset;
+        return std::binary_search(first, first + document_data.unique_word_count, term_id);
+    }
+    const auto it = word_to_document_freqs_.find(term_id_to_word_[term_id]);
+    return it != word_to_document_freqs_.end() && it->second.count(document_id) != 0;
+}
+
+void SearchServer::AppendForwardIndex(DocumentData& document_data, const std::vector<int>& term_ids, const std::vector<double>& term_freqs) {
+    if (!forward_index_enabled_) {
+        return;
+    }
+    document_data.forward_offset = forward_term_ids_.size();
+    forward_term_ids_.insert(forward_term_ids_.end(), term_ids.begin(), term_ids.end());
+    forward_term_freqs_.insert(forward_term_freqs_.end(), term_freqs.begin(), term_freqs.end());
+}
+
+void SearchServer::ReleaseForwardIndex(const DocumentData& document_data) {
+    if (!forward_index_enabled_) {
+        return;
+    }
+    forward_index_garbage_ += document_data.unique_word_count;
+    if (forward_index_garbage_ > 1024 && forward_index_garbage_ * 2 > forward_term_ids_.size()) {
+        CompactForwardIndex();
+    }
+}
+
+void SearchServer::CompactForwardIndex() {
+    std::pmr::vector<int> term_ids(memory_resource_);
+    std::pmr::vector<double> term_freqs(memory_resource_);
+    term_ids.reserve(forward_term_ids_.size() - forward_index_garbage_);
+    term_freqs.reserve(forward_term_ids_.size() - forward_index_garbage_);
+    for (auto& [_, document_data] : documents_) {
+        const size_t first = document_data.forward_offset;
+        const size_t last = first + document_data.unique_word_count;
+        document_data.forward_offset = term_ids.size();
+        term_ids.insert(term_ids.end(), forward_term_ids_.begin() + first, forward_term_ids_.begin() + last);
+        term_freqs.insert(term_freqs.end(), forward_term_freqs_.begin() + first, forward_term_freqs_.begin() + last);
+    }
+    forward_term_ids_ = std::move(term_ids);
+    forward_term_freqs_ = std::move(term_freqs);
+    forward_index_garbage_ = 0;
+}
+
+DocumentFingerprint SearchServer::ComputeDocumentFingerprint(const std::vector<int>& term_ids) const {
+    DocumentFingerprint fingerprint;
+    for (const int term_id : term_ids) {
+        fingerprint.AddWord(term_id_to_word_[term_id]);
+    }
+    return fingerprint;
+}
+
+std::optional<int> SearchServer::FindOriginalDocument(const std::vector<std::string_view>& words) const {
+    std::vector<int> term_ids;
+    term_ids.reserve(words.size());
+    for (const auto word : words) {
+        const auto term_id = FindTermId(word);
+        if (!term_id) {
+            // Документ с новым словом не может совпадать с уже добавленным
+            return std::nullopt;
+        }
+        term_ids.push_back(*term_id);
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+
+    const auto it = fingerprint_to_document_ids_.find(ComputeDocumentFingerprint(term_ids));
+    if (it == fingerprint_to_document_ids_.end()) {
+        return std::nullopt;
+    }
+    for (const int document_id : it->second) {
+        const auto& document_data = documents_.at(document_id);
+        if (document_data.unique_word_count == static_cast<int>(term_ids.size())
+            && std::all_of(term_ids.begin(), term_ids.end(), [this, document_id, &document_data](const int term_id) {
+                return DocumentContainsTerm(document_id, document_data, term_id);
+                })) {
+            return document_id;
+        }
+    }
+    return std::nullopt;
+}
+
+bool SearchServer::RemoveAlias(int document_id) {
+    const auto it = alias_to_document_id_.find(document_id);
+    if (it == alias_to_document_id_.end()) {
+        return false;
+    }
+    auto& aliases = document_id_to_aliases_.at(it->second);
+    aliases.erase(std::find(aliases.begin(), aliases.end(), document_id));
+    if (aliases.empty()) {
+        document_id_to_aliases_.erase(it->second);
+    }
+    alias_to_document_id_.erase(it);
+    return true;
+}
+
+// Вместе с оригиналом удаляются и его псевдонимы
+void SearchServer::ForgetDocumentFingerprint(int document_id, const std::vector<int>& term_ids) {
+    const auto aliases_it = document_id_to_aliases_.find(document_id);
+    if (aliases_it != document_id_to_aliases_.end()) {
+        for (const int alias_id : aliases_it->second) {
+            alias_to_document_id_.erase(alias_id);
+        }
+        document_id_to_aliases_.erase(aliases_it);
+    }
+
+    if (duplicate_policy_ == DuplicatePolicy::KEEP) {
+        return;
+    }
+    const auto it = fingerprint_to_document_ids_.find(ComputeDocumentFingerprint(term_ids));
+    auto& document_ids = it->second;
+    document_ids.erase(std::find(document_ids.begin(), document_ids.end(), document_id));
+    if (document_ids.empty()) {
+        fingerprint_to_document_ids_.erase(it);
+    }
+}
+
+void SearchServer::EraseDocumentAttributes(int document_id) {
+    const auto& document_data = documents_.at(document_id);
+    total_word_count_ -= document_data.word_count;
+    status_to_documents_.at(document_data.status).Erase(document_id);
+    auto rating_it = rating_to_documents_.find(document_data.rating);
+    rating_it->second.Erase(document_id);
+    if (rating_it->second.Empty()) {
+        rating_to_documents_.erase(rating_it);
+    }
+    document_ratings_.Erase(document_id);
+}
+
+SearchServer::ResolvedFilter SearchServer::ResolveFilter(const DocumentFilter& document_filter) const {
+    ResolvedFilter filter;
+    filter.ratings = &document_ratings_;
+    // Пустой список статусов и список из всех статусов индекса пропускают любой документ
+    if (!document_filter.statuses.empty()) {
+        for (const auto& [status, documents] : status_to_documents_) {
+            if (std::find(document_filter.statuses.begin(), document_filter.statuses.end(), status) != document_filter.statuses.end()) {
+                filter.status_documents.push_back(&documents);
+            }
+        }
+        filter.any_status = filter.status_documents.size() == status_to_documents_.size();
+    }
+    if (document_filter.HasRatingRange()) {
+        filter.any_rating = false;
+        filter.min_rating = document_filter.min_rating;
+        filter.max_rating = document_filter.max_rating;
+        for (auto it = rating_to_documents_.lower_bound(document_filter.min_rating);
+            it != rating_to_documents_.end() && it->first <= document_filter.max_rating; ++it) {
+            if (filter.rating_documents.size() == MAX_RATING_PROBES) {
+                filter.rating_documents.clear();
+                return filter;
+            }
+            filter.rating_documents.push_back(&it->second);
+        }
+        filter.probe_ratings = true;
+    }
+    return filter;
+}
+
+int SearchServer::CountMatches(const std::string_view raw_query) const {
+    return CountMatches(raw_query, DocumentFilter(DocumentStatus::ACTUAL));
+}
+
+int SearchServer::CountMatches(const std::string_view raw_query, const DocumentFilter& document_filter) const {
+    return static_cast<int>(FindMatchingDocuments(raw_query, document_filter).Count());
+}
+
+MatchAggregation SearchServer::Aggregate(const std::string_view raw_query, const DocumentFilter& document_filter, int rating_bucket_width) const {
+    if (rating_bucket_width <= 0) {
+        throw std::invalid_argument("rating bucket width must be positive");
+    }
+    const DocumentBitmap matched_documents = FindMatchingDocuments(raw_query, document_filter);
+
+    MatchAggregation aggregation;
+    aggregation.total = static_cast<int>(matched_documents.Count());
+    if (aggregation.total == 0) {
+        return aggregation;
+    }
+    for (const auto& [status, documents] : status_to_documents_) {
+        if (const size_t count = matched_documents.CountIntersection(documents)) {
+            aggregation.status_counts[status] = static_cast<int>(count);
+        }
+    }
+    for (auto it = rating_to_documents_.lower_bound(document_filter.min_rating);
+        it != rating_to_documents_.end() && it->first <= document_filter.max_rating; ++it) {
+        if (const size_t count = matched_documents.CountIntersection(it->second)) {
+            const int64_t remainder = (static_cast<int64_t>(it->first) % rating_bucket_width + rating_bucket_width) % rating_bucket_width;
+            const int64_t bucket = std::max<int64_t>(it->first - remainder, std::numeric_limits<int>::min());
+            aggregation.rating_bucket_counts[static_cast<int>(bucket)] += static_cast<int>(count);
+        }
+    }
+    return aggregation;
+}
+
+const DocumentBitmap* SearchServer::GetTermBitmap(int term_id, const std::pmr::map<int, double>& id_freqs) const {
+    if (id_freqs.size() < MIN_CACHED_BITMAP_POSTINGS) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(term_bitmaps_mutex_);
+    // Узлы unordered_map не перемещаются при рехешировании, указатель на карту остаётся действительным
+    const auto [it, inserted] = term_to_bitmap_.try_emplace(term_id);
+    if (inserted) {
+        // Список документов обходится по возрастанию ID, поэтому вставка в битовую карту идёт в конец блока
+        for (const auto& [document_id, _] : id_freqs) {
+            it->second.Insert(document_id);
+        }
+    }
+    return &it->second;
+}
+
+void SearchServer::InvalidateTermBitmap(int term_id) {
+    if (!term_to_bitmap_.empty()) {
+        term_to_bitmap_.erase(term_id);
+    }
+}
+
+DocumentBitmap SearchServer::FindMatchingDocuments(const std::string_view raw_query, const DocumentFilter& document_filter) const {
+    const auto query = ParseQuery(raw_query);
+    const auto find_postings = [this](std::string_view word) -> std::pair<int, const std::pmr::map<int, double>*> {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end()) {
+            return { 0, nullptr };
+        }
+        return { *FindTermId(word), &it->second };
+    };
+
+    DocumentBitmap matched_documents;
+    for (const auto word : query.plus_words) {
+        const auto [term_id, id_freqs] = find_postings(word);
+        if (!id_freqs) {
+            continue;
+        }
+        if (const DocumentBitmap* documents = GetTermBitmap(term_id, *id_freqs)) {
+            matched_documents |= *documents;
+            continue;
+        }
+        for (const auto& [document_id, _] : *id_freqs) {
+            matched_documents.Insert(document_id);
+        }
+    }
+    if (matched_documents.Empty()) {
+        return matched_documents;
+    }
+    for (const auto word : query.minus_words) {
+        const auto [term_id, id_freqs] = find_postings(word);
+        if (!id_freqs) {
+            continue;
+        }
+        if (const DocumentBitmap* documents = GetTermBitmap(term_id, *id_freqs)) {
+            matched_documents -= *documents;
+            continue;
+        }
+        for (const auto& [document_id, _] : *id_freqs) {
+            matched_documents.Erase(document_id);
+        }
+    }
+
+    const ResolvedFilter filter = ResolveFilter(document_filter);
+    if (filter.any_rating && filter.status_documents.size() == 1) {
+        matched_documents &= *filter.status_documents.front();
+    }
+    else if (!filter.any_status || !filter.any_rating) {
+        // Проверяются только найденные документы, по возрастанию ID, поэтому вставка идёт в конец блока
+        DocumentBitmap filtered_documents;
+        matched_documents.ForEach([&filter, &filtered_documents](int document_id) {
+            if (filter.Contains(document_id)) {
+                filtered_documents.Insert(document_id);
+            }
+            });
+        matched_documents = std::move(filtered_documents);
+    }
+    return matched_documents;
+}
 
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+double SearchServer::GetAverageWordCount() const {
+    return documents_.empty() ? 0.0 : static_cast<double>(total_word_count_) / documents_.size();
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) {
@@ -255,7 +1224,7 @@ bool SearchServer::IsValidStopWord(const std::string_view word) {
 
 bool SearchServer::CheckID(const int& id) const {
 
-    return (documents_.count(id) != 0 || id < 0) ? false : true;
+    return (documents_.count(id) != 0 || alias_to_document_id_.count(id) != 0 || id < 0) ? false : true;
 
 }
 
@@ -1,14 +1,36 @@
 #pragma once
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <set>
 #include <stdexcept>
 #include <queue>
 #include <cmath>
 #include <execution>
+#include <iterator>
 #include <list>
 #include <string_view>
+#include <limits>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 
 #include "document.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "document_fingerprint.h"
+#include "document_bitmap.h"
+#include "document_column.h"
+#include "scoring.h"
+#include "impact_index.h"
+#include "fuzzy_term_index.h"
+#include "term_dictionary.h"
+#include "metrics.h"
+#include "query_profile.h"
+#include "query_budget.h"
+#include "write_ahead_log.h"
 //#include "log_duration.h"
 
 using namespace std::literals;
@@ -16,63 +38,306 @@ using namespace std::literals;
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 const double ERROR_RATE = 1e-6;
 
+// Обработка документа, множество слов которого совпадает с уже добавленным документом
+enum class DuplicatePolicy {
+    KEEP,   // документ индексируется как обычно
+    REJECT, // AddDocument выбрасывает std::invalid_argument
+    ALIAS,  // документ не индексируется и запоминается как псевдоним оригинала
+};
+
+// Частоты слов документа из прямого индекса: пары (слово, TF) в порядке ID слов.
+// Представление не владеет данными и действительно до следующего изменения сервера
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const int* term_id, const double* term_freq, const std::pmr::vector<std::string_view>* term_id_to_word)
+            : term_id_(term_id)
+            , term_freq_(term_freq)
+            , term_id_to_word_(term_id_to_word) {
+        }
+
+        value_type operator*() const {
+            return { (*term_id_to_word_)[*term_id_], *term_freq_ };
+        }
+
+        Iterator& operator++() {
+            ++term_id_;
+            ++term_freq_;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return term_id_ == other.term_id_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const int* term_id_;
+        const double* term_freq_;
+        const std::pmr::vector<std::string_view>* term_id_to_word_;
+    };
+
+    WordFrequencies() = default;
+
+    WordFrequencies(const int* term_ids, const double* term_freqs, size_t size, const std::pmr::vector<std::string_view>* term_id_to_word)
+        : term_ids_(term_ids)
+        , term_freqs_(term_freqs)
+        , size_(size)
+        , term_id_to_word_(term_id_to_word) {
+    }
+
+    Iterator begin() const {
+        return { term_ids_, term_freqs_, term_id_to_word_ };
+    }
+
+    Iterator end() const {
+        return { term_ids_ + size_, term_freqs_ + size_, term_id_to_word_ };
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    const int* term_ids_ = nullptr;
+    const double* term_freqs_ = nullptr;
+    size_t size_ = 0;
+    const std::pmr::vector<std::string_view>* term_id_to_word_ = nullptr;
+};
+
 class SearchServer {
 public:
 
+    // Обратный и прямой индексы, словарь и данные документов размещаются в resource, который должен жить дольше сервера.
+    // С std::pmr::monotonic_buffer_resource узлы индекса лежат подряд в арене и не освобождаются по одному,
+    // с пулом освобождённые узлы переиспользуются при изменениях. Параллельное удаление документов освобождает
+    // память из нескольких потоков, для него подходят арена и synchronized_pool_resource, но не unsynchronized_pool_resource
     template <typename StopWordsContainer>
-    explicit SearchServer(const StopWordsContainer& stop_words);
+    explicit SearchServer(const StopWordsContainer& stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
-    explicit SearchServer(const std::string& stop_words);
-    explicit SearchServer(const std::string_view stop_words);
+    explicit SearchServer(const std::string& stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    explicit SearchServer(const std::string_view stop_words, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+    void SetDuplicatePolicy(DuplicatePolicy policy);
+
+    // ID оригинала для псевдонима, для проиндексированного документа - его собственный ID
+    int GetOriginalDocumentId(int document_id) const;
+
+    // Строит индекс квантованных вкладов для FindTopDocuments<QuantizedImpactScoring>.
+    // Индекс сбрасывается при любом добавлении или удалении документа
+    void BuildImpactIndex(ImpactPrecision precision = ImpactPrecision::UINT8);
+
+    // Политика ранжирования задаётся первым параметром шаблона: FindTopDocuments<Bm25Scoring>(...).
+    // Во всех перегрузках, кроме QueryMatchMode::ALL, плюс-слово с '*' на конце (pho*) заменяется
+    // словами с этим префиксом, не более MAX_PREFIX_EXPANSIONS самых частых
+    template <typename Scoring = TfIdfScoring>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
-    template <typename ExecutionPolicy>
+    template <typename Scoring = TfIdfScoring, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query) const;
 
+    template <typename Scoring = TfIdfScoring>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus document_status) const;
 
-    template <typename ExecutionPolicy>
+    template <typename Scoring = TfIdfScoring, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus document_status) const;
 
-    template <typename DocumentPredicate>
+    template <typename Scoring = TfIdfScoring, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
 
-    template <typename DocumentPredicate, typename ExecutionPolicy>
+    template <typename Scoring = TfIdfScoring, typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
 
+    // Фильтр применяется пересечением с индексами статусов и рейтингов, без обращения к данным документа на каждое вхождение слова.
+    // Запрос TfIdfScoring из одного плюс-слова с фильтром по одному статусу выдаётся по списку чемпионов слова, если он есть.
+    // Так же выдаются запросы перегрузок с бюджетом и с QueryMatchMode
+    template <typename Scoring = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter) const;
+
+    template <typename Scoring = TfIdfScoring, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter) const;
+
+    // Страница выдачи после курсора: не более page_size документов в порядке SearchCursor.
+    // Курсор следующей страницы строится по её последнему документу, предыдущие страницы не сортируются и не копируются
+    template <typename Scoring = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, const SearchCursor& cursor, size_t page_size) const;
+
+    template <typename Scoring = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter, const SearchCursor& cursor, size_t page_size) const;
+
+    template <typename Scoring = TfIdfScoring, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter, const SearchCursor& cursor, size_t page_size) const;
+
+    // Поиск с ограничением по времени или числу просмотренных записей индекса. Плюс-слова обрабатываются
+    // от редких к частым, и при исчерпании бюджета возвращаются лучшие из уже найденных документов с флагом partial.
+    // Минус-слова применяются всегда полностью. Индекс вкладов QuantizedImpactScoring бюджет не ограничивает
+    template <typename Scoring = TfIdfScoring>
+    PartialSearchResult FindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter, const QueryBudget& budget) const;
+
+    template <typename Scoring = TfIdfScoring, typename ExecutionPolicy>
+    PartialSearchResult FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter, const QueryBudget& budget) const;
+
+    // При QueryMatchMode::ALL документ должен содержать все плюс-слова. Списки документов слов пересекаются
+    // от короткого к длинному, и оцениваются только документы пересечения, поэтому стоимость запроса
+    // определяется длиной списка самого редкого слова. Релевантность та же, что и при QueryMatchMode::ANY
+    template <typename Scoring = TfIdfScoring>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter, QueryMatchMode match_mode) const;
+
+    template <typename Scoring = TfIdfScoring, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter, QueryMatchMode match_mode) const;
+
+    // Выдача FindTopDocuments вместе со статистикой слов, размером аккумулятора и временем стадий.
+    // Запрос идёт тем же путём, что и без профиля, выдача по списку чемпионов отмечается индексом "champion"
+    template <typename Scoring = TfIdfScoring>
+    std::vector<Document> ProfileFindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter, QueryProfile& profile) const;
+
+    template <typename Scoring = TfIdfScoring, typename ExecutionPolicy>
+    std::vector<Document> ProfileFindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter, QueryProfile& profile) const;
+
     int GetDocumentCount() const;
 
+    // Число подходящих документов: плюс- и минус-слова вычисляются объединением и разностью
+    // битовых карт списков документов, релевантность не считается
+    int CountMatches(const std::string_view raw_query) const;
+    int CountMatches(const std::string_view raw_query, const DocumentFilter& document_filter) const;
+
+    // Фасеты подходящих документов по статусам и корзинам рейтингов шириной rating_bucket_width
+    // Фильтр по умолчанию, как и у CountMatches, - статус ACTUAL
+    MatchAggregation Aggregate(const std::string_view raw_query, const DocumentFilter& document_filter = DocumentFilter(DocumentStatus::ACTUAL), int rating_bucket_width = 1) const;
+
     using DocQueryAndStatus = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 
     DocQueryAndStatus MatchDocument(const std::string_view raw_query, int document_id) const;
     DocQueryAndStatus MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
     DocQueryAndStatus MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
 
-    std::set<int>::iterator begin();
+    // Запрос разбирается один раз и сопоставляется сразу с несколькими документами
+    std::vector<DocQueryAndStatus> MatchDocuments(std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    DocQueryAndStatus ProfileMatchDocument(std::string_view raw_query, int document_id, QueryProfile& profile) const;
+
+    std::vector<DocQueryAndStatus> MatchDocuments(const std::execution::sequenced_policy&, std::string_view raw_query, const std::vector<int>& document_ids) const;
+    std::vector<DocQueryAndStatus> MatchDocuments(const std::execution::parallel_policy&, std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    std::pmr::set<int>::iterator begin();
 
-    std::set<int>::iterator end();
+    std::pmr::set<int>::iterator end();
+
+    std::pmr::set<int>::const_iterator begin() const;
+
+    std::pmr::set<int>::const_iterator end() const;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Пакетное удаление: каждый затронутый список документов слова обходится один раз
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // Требует прямого индекса, без него выбрасывает std::logic_error
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+    // Прямой индекс нужен GetWordFrequencies и ускоряет MatchDocument и RemoveDocument.
+    // Без него MatchDocument обращается к обратному индексу, а удаление документа перебирает весь словарь
+    void SetForwardIndexEnabled(bool enabled);
+
+    // Запечатывает словарь готового индекса: строит сжатый словарь слов (TermDictionary), переносит тексты слов
+    // в один буфер и освобождает дерево слово - ID слова. Пока словарь запечатан, слова запроса ищутся в нём,
+    // а самые частые слова с префиксом выбираются по границам частоты блоков словаря. Добавление или удаление
+    // документа распечатывает словарь: дерево слово - ID слова восстанавливается из словаря. Без словаря
+    // слова с префиксом перебираются по обратному индексу
+    void SealTermDictionary();
+
+    bool IsTermDictionarySealed() const;
+
+    // Неизвестные словарю плюс-слова запросов FindTopDocuments заменяются ближайшими словами словаря на расстоянии
+    // до options.max_edit_distance правок. Вес замены понижается в distance_penalty раз за каждую правку.
+    // Индекс удалений строится по словарю и ведётся при появлении и исчезновении слов. Замены ищутся, только если
+    // слова нет в словаре, поэтому запросы без опечаток не замедляются. QueryMatchMode::ALL, MatchDocument
+    // и CountMatches слова не заменяют
+    void SetFuzzySearchEnabled(bool enabled, FuzzySearchOptions options = FuzzySearchOptions());
+
+    // Успешные добавления и удаления документов записываются в журнал, nullptr отключает запись.
+    // Журнал не принадлежит серверу и должен быть отключён или жить дольше сервера
+    void SetWriteAheadLog(WriteAheadLog* write_ahead_log);
 
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
+        int word_count;        // Длина документа без стоп-слов для политик, учитывающих длину
+        int unique_word_count;
+        size_t forward_offset; // Начало слов документа в прямом индексе
     };
 
+    std::pmr::memory_resource* memory_resource_; // Объявлен первым: им инициализируются контейнеры ниже
     std::set<std::string, std::less<>> stop_words_; // Контейнер стоп-слов
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_; // Контейнер слово - word и ID-TF
-    std::map<int, DocumentData> documents_; // ID Документа и его рейтинг и статус
-    std::set<int> added_doc_id_;
-    std::map<int, std::map<std::string_view, double>> doc_id_words_freq_;
-    std::set<std::string, std::less<>> word_of_documents_;
+    std::pmr::map<std::string_view, std::pmr::map<int, double>> word_to_document_freqs_{ memory_resource_ }; // Контейнер слово - word и ID-TF
+    std::pmr::map<int, DocumentData> documents_{ memory_resource_ }; // ID Документа и его рейтинг и статус
+    std::pmr::set<int> added_doc_id_{ memory_resource_ };
+    std::pmr::map<std::pmr::string, int, std::less<>> word_to_term_id_{ memory_resource_ }; // Словарь слово - ID слова
+    std::pmr::vector<std::string_view> term_id_to_word_{ memory_resource_ };
+    DuplicatePolicy duplicate_policy_ = DuplicatePolicy::KEEP;
+    std::unordered_map<DocumentFingerprint, std::vector<int>, DocumentFingerprintHasher> fingerprint_to_document_ids_; // Ведётся только при политике, отличной от KEEP
+    std::map<int, int> alias_to_document_id_;
+    std::map<int, std::vector<int>> document_id_to_aliases_;
+    std::map<DocumentStatus, DocumentBitmap> status_to_documents_;
+    std::map<int, DocumentBitmap> rating_to_documents_; // Карты документов по рейтингу для фильтрации по диапазону
+    DocumentColumn document_ratings_; // Рейтинги по ID для диапазонов шире MAX_RATING_PROBES рейтингов
+    int64_t total_word_count_ = 0;
+
+    // Список чемпионов: лучшие документы слова с одним статусом по TF, затем по рейтингу. Для запроса из одного слова
+    // IDF общий у всех документов, поэтому порядок списка совпадает с порядком выдачи и не меняется при изменении IDF
+    struct Champion {
+        int document_id;
+        double term_freq;
+        int rating;
+    };
+
+    struct ChampionList {
+        std::vector<Champion> champions; // Не больше CHAMPION_LIST_SIZE, лучшие первыми
+        bool complete = true;            // В списке все документы слова с этим статусом
+    };
+
+    static const size_t CHAMPION_LIST_SIZE = 64;
+    static const size_t CHAMPION_MIN_POSTINGS = 256; // Списки ведутся для слов не реже, удаляются при вдвое меньшей частоте
+    std::unordered_map<int, std::map<DocumentStatus, ChampionList>> term_to_champions_;
+    ImpactIndex impact_index_;
+    // Битовые карты списков документов частых слов для CountMatches и Aggregate: строятся при первом запросе слова
+    // и сбрасываются при изменении его списка. Заполняются из константных методов, поэтому под мьютексом
+    static const size_t MIN_CACHED_BITMAP_POSTINGS = 256;
+    mutable std::mutex term_bitmaps_mutex_;
+    mutable std::unordered_map<int, DocumentBitmap> term_to_bitmap_;
+    // Прямой индекс: отсортированные ID слов и их TF всех документов в двух общих массивах,
+    // документ занимает участок [forward_offset, forward_offset + unique_word_count)
+    bool forward_index_enabled_ = true;
+    std::pmr::vector<int> forward_term_ids_{ memory_resource_ };
+    std::pmr::vector<double> forward_term_freqs_{ memory_resource_ };
+    size_t forward_index_garbage_ = 0; // Записи удалённых документов до уплотнения
+    std::optional<FuzzyTermIndex> fuzzy_term_index_; // Есть, только пока включён нечёткий поиск
+    FuzzySearchOptions fuzzy_search_options_;
+    // Запечатанный словарь: вес слова - число документов с ним. Пока словарь построен, дерево word_to_term_id_ пусто,
+    // а тексты слов лежат подряд в sealed_words_
+    TermDictionary term_dictionary_{ memory_resource_ };
+    std::pmr::string sealed_words_{ memory_resource_ };
+    static const size_t MAX_PREFIX_EXPANSIONS = 64;
+    WriteAheadLog* write_ahead_log_ = nullptr;
 
     bool IsStopWord(const std::string_view word) const;
 
@@ -91,18 +356,190 @@ private:
     struct Query {
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        QueryMatchMode match_mode = QueryMatchMode::ANY;
+        std::vector<double> plus_word_weights; // Множители весов плюс-слов, пустой - все равны 1
     };
 
     Query ParseQuery(const std::string_view text, bool sort = true) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    // Слово появилось в обратном индексе или исчезло из него
+    void RegisterWord(int term_id, std::string_view word);
+
+    void ForgetWord(int term_id, std::string_view word);
+
+    // Восстанавливает дерево слово - ID слова из запечатанного словаря перед изменением индекса
+    void UnsealTermDictionary();
+
+    // Переносит тексты слов обратного индекса на новое хранилище: words - новые тексты в порядке слов индекса
+    void RebindWords(const std::vector<std::pair<int, std::string_view>>& words);
+
+    // ID слова по дереву слово - ID слова или по запечатанному словарю
+    std::optional<int> FindTermId(std::string_view word) const;
+
+    // Заменяет плюс-слова с '*' на конце словами с этим префиксом
+    void ExpandPrefixWords(Query& query) const;
+
+    // Добавляет в конец плюс-слов замены неизвестных словарю слов с пониженным весом
+    void ExpandFuzzyWords(Query& query) const;
+
+    // Запрос в виде отсортированных ID слов, отсутствующие в словаре слова отброшены
+    struct TermQuery {
+        std::vector<int> plus_term_ids;
+        std::vector<int> minus_term_ids;
+    };
+
+    TermQuery ParseTermQuery(const std::string_view text) const;
+
+    std::vector<int> FindTermIds(const std::vector<std::string_view>& words) const;
+
+    std::vector<std::string_view> MatchDocumentTerms(const TermQuery& query, int document_id, const DocumentData& document_data) const;
+
+    const DocumentData& GetDocumentData(int document_id) const;
+
+    // Отсортированные ID слов документа: из прямого индекса или, без него, перебором обратного
+    std::vector<int> GetDocumentTermIds(int document_id) const;
+
+    bool DocumentContainsTerm(int document_id, const DocumentData& document_data, int term_id) const;
+
+    void AppendForwardIndex(DocumentData& document_data, const std::vector<int>& term_ids, const std::vector<double>& term_freqs);
+
+    void ReleaseForwardIndex(const DocumentData& document_data);
+
+    void CompactForwardIndex();
+
+    DocumentFingerprint ComputeDocumentFingerprint(const std::vector<int>& term_ids) const;
+
+    std::optional<int> FindOriginalDocument(const std::vector<std::string_view>& words) const;
+
+    bool RemoveAlias(int document_id);
+
+    void ForgetDocumentFingerprint(int document_id, const std::vector<int>& term_ids);
+
+    void EraseDocumentAttributes(int document_id);
+
+    static bool IsBetterChampion(const Champion& lhs, const Champion& rhs);
+
+    void BuildChampionLists(int term_id);
+
+    void AddToChampionLists(int term_id, int document_id, double term_freq, const DocumentData& document_data);
+
+    // Вызывается после удаления документов из списка документов слова, пока их данные ещё есть в documents_
+    void RemoveFromChampionLists(int term_id, const std::vector<int>& document_ids);
+
+    // Выдача запроса из одного плюс-слова по списку чемпионов. nullopt, если списка нет
+    // или документ за его пределами может попасть в выдачу из-за погрешности сравнения релевантности
+    std::optional<std::vector<Document>> FindChampionDocuments(const Query& query, const DocumentFilter& document_filter) const;
+
+    static const size_t MAX_RATING_PROBES = 4;
+
+    // Фильтр, разрешённый в битовые индексы. Объединения карт не строятся, иначе каждый запрос с диапазоном
+    // рейтингов или несколькими статусами стоил бы O(числа документов) ещё до оценки. Кандидат проверяется
+    // по картам своих статусов, рейтинг - по картам рейтингов диапазона, если их не больше MAX_RATING_PROBES,
+    // иначе по столбцу рейтингов
+    struct ResolvedFilter {
+        const DocumentColumn* ratings;
+        bool any_status = true;
+        std::vector<const DocumentBitmap*> status_documents;
+        bool any_rating = true;
+        int min_rating = std::numeric_limits<int>::min();
+        int max_rating = std::numeric_limits<int>::max();
+        bool probe_ratings = false;
+        std::vector<const DocumentBitmap*> rating_documents;
+
+        bool Contains(int document_id) const {
+            const auto contains = [document_id](const DocumentBitmap* documents) {
+                return documents->Contains(document_id);
+            };
+            if (!any_status && std::none_of(status_documents.begin(), status_documents.end(), contains)) {
+                return false;
+            }
+            if (any_rating) {
+                return true;
+            }
+            if (probe_ratings) {
+                return std::any_of(rating_documents.begin(), rating_documents.end(), contains);
+            }
+            const int rating = ratings->Get(document_id);
+            return rating >= min_rating && rating <= max_rating;
+        }
+    };
+
+    ResolvedFilter ResolveFilter(const DocumentFilter& document_filter) const;
+
+    // select_documents оставляет в векторе документов нужную часть выдачи в порядке выдачи.
+    // champion_filter передаётся, если select_documents отбирает MAX_RESULT_DOCUMENT_COUNT лучших документов,
+    // прошедших этот фильтр: тогда разобранный запрос сначала пробует список чемпионов
+    template <typename Scoring, typename ExecutionPolicy, typename DocumentIdFilter, typename DocumentSelector>
+    std::vector<Document> FindTopDocumentsByIdFilter(ExecutionPolicy& policy, const std::string_view raw_query, DocumentIdFilter document_id_filter, DocumentSelector select_documents,
+        QueryProfile* profile = nullptr, QueryBudgetTracker* budget = nullptr, QueryMatchMode match_mode = QueryMatchMode::ANY,
+        const DocumentFilter* champion_filter = nullptr) const;
+
+    // Заполняет слова профиля: длину списка документов и вес каждого слова
+    template <typename Scoring>
+    void StartQueryProfile(const Query& query, QueryProfile& profile) const;
+
+    // Битовая карта списка документов частого слова из кеша, для редкого слова - nullptr:
+    // его документы добавляются в результат и вычитаются из него напрямую по списку
+    const DocumentBitmap* GetTermBitmap(int term_id, const std::pmr::map<int, double>& id_freqs) const;
+
+    void InvalidateTermBitmap(int term_id);
+
+    // Документы, содержащие хотя бы одно плюс-слово и ни одного минус-слова, с учётом фильтра
+    DocumentBitmap FindMatchingDocuments(const std::string_view raw_query, const DocumentFilter& document_filter) const;
+
+    double GetAverageWordCount() const;
+
+    // Диапазон ID документов [first, last], обрабатываемый одним потоком
+    struct DocumentIdRange {
+        int first;
+        int last;
+    };
+
+    static constexpr DocumentIdRange ALL_DOCUMENT_IDS{ 0, std::numeric_limits<int>::max() };
+
+    std::vector<DocumentIdRange> SplitDocumentIdRanges() const;
+
+    static bool CompareDocuments(const Document& lhs, const Document& rhs);
+
+    static void SelectTopDocuments(std::vector<Document>& documents, size_t count);
+
+    // Ограниченный отбор page_size документов после курсора за линейное время от числа найденных
+    static void SelectPage(std::vector<Document>& documents, const SearchCursor& cursor, size_t page_size);
 
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+    // Позиция в списке документов слова при пересечении списков
+    struct PostingCursor {
+        const std::pmr::map<int, double>* id_freqs;
+        std::pmr::map<int, double>::const_iterator it;
+        double term_weight;
+        size_t word_index;
+        uint64_t postings_visited = 0;
+
+        // Сдвигает курсор к первому документу с ID не меньше document_id, false - если такого нет.
+        // Близкий документ достигается несколькими шагами итератора, далёкий - поиском по дереву, поэтому
+        // как и при галопирующем поиске, сдвиг стоит не больше меньшего из расстояния и логарифма длины списка
+        bool Seek(int document_id);
+    };
+
+    // Документы диапазона, содержащие все плюс-слова и ни одного минус-слова
+    template<typename Scoring, typename DocumentIdFilter>
+    std::vector<Document> FindConjunctiveDocumentsInRange(const Query& query, DocumentIdRange range, DocumentIdFilter document_id_filter, QueryProfile* profile) const;
+
+    template<typename DocumentIdFilter>
+    std::vector<Document> FindDocumentsByImpactInRange(const Query& query, DocumentIdRange range, DocumentIdFilter document_id_filter, QueryProfile* profile) const;
+
+    // profile равен nullptr, если профиль не запрошен, budget - если поиск не ограничен
+    template<typename Scoring, typename DocumentIdFilter>
+    std::vector<Document> FindDocumentsInRange(const Query& query, DocumentIdRange range, DocumentIdFilter document_id_filter, QueryProfile* profile,
+        QueryBudgetTracker* budget) const;
+
+    template<typename Scoring, typename DocumentIdFilter>
+    std::vector<Document> FindAllDocuments(const Query& query, DocumentIdFilter document_id_filter, QueryProfile* profile = nullptr, QueryBudgetTracker* budget = nullptr) const;
+    template<typename Scoring, typename DocumentIdFilter, typename DocumentSelector>
+    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentIdFilter document_id_filter, DocumentSelector select_documents,
+        QueryProfile* profile, QueryBudgetTracker* budget) const;
+    template<typename Scoring, typename DocumentIdFilter, typename DocumentSelector>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentIdFilter document_id_filter, DocumentSelector select_documents,
+        QueryProfile* profile, QueryBudgetTracker* budget) const;
 
     static bool IsValidWord(const std::string_view word);
 
@@ -112,7 +549,9 @@ private:
 };
 
 template <typename StopWordsContainer>
-SearchServer::SearchServer(const StopWordsContainer& stop_words) : stop_words_(UniqueContainerWithoutEmpty(stop_words))
+SearchServer::SearchServer(const StopWordsContainer& stop_words, std::pmr::memory_resource* resource)
+    : memory_resource_(resource)
+    , stop_words_(UniqueContainerWithoutEmpty(stop_words))
 {
     for (const auto& word : stop_words) {
         if (!IsValidWord(word)) {
@@ -121,69 +560,312 @@ SearchServer::SearchServer(const StopWordsContainer& stop_words) : stop_words_(U
     }
 }
 
-template <typename ExecutionPolicy>
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
+    return FindTopDocuments<Scoring>(std::execution::seq, raw_query);
+}
+
+template <typename Scoring, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query) const {
-    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    return FindTopDocuments<Scoring>(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus document_status) const {
+    return FindTopDocuments<Scoring>(std::execution::seq, raw_query, document_status);
 }
 
-template <typename ExecutionPolicy>
+template <typename Scoring, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus document_status) const {
-    return FindTopDocuments(policy, raw_query, [document_status](int document_id, DocumentStatus status, int rating) { return status == document_status; });
+    return FindTopDocuments<Scoring>(policy, raw_query, DocumentFilter(document_status));
 }
 
-template <typename DocumentPredicate>
+template <typename Scoring, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    return FindTopDocuments<Scoring>(std::execution::seq, raw_query, document_predicate);
 }
 
-template <typename DocumentPredicate, typename ExecutionPolicy>
+template <typename Scoring, typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    return FindTopDocumentsByIdFilter<Scoring>(policy, raw_query, [this, &document_predicate](int document_id) {
+        const auto& document_id_data = documents_.at(document_id);
+        return document_predicate(document_id, document_id_data.status, document_id_data.rating);
+        }, [](std::vector<Document>& documents) {
+            SelectTopDocuments(documents, MAX_RESULT_DOCUMENT_COUNT);
+        });
+}
 
-    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < ERROR_RATE) {
-            return lhs.rating > rhs.rating;
-        }
-        else {
-            return lhs.relevance > rhs.relevance;
-        }
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter) const {
+    return FindTopDocuments<Scoring>(std::execution::seq, raw_query, document_filter);
+}
+
+template <typename Scoring, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter) const {
+    const ResolvedFilter filter = ResolveFilter(document_filter);
+    return FindTopDocumentsByIdFilter<Scoring>(policy, raw_query, [&filter](int document_id) {
+        return filter.Contains(document_id);
+        }, [](std::vector<Document>& documents) {
+            SelectTopDocuments(documents, MAX_RESULT_DOCUMENT_COUNT);
+        }, nullptr, nullptr, QueryMatchMode::ANY, &document_filter);
+}
+
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, const SearchCursor& cursor, size_t page_size) const {
+    return FindTopDocuments<Scoring>(std::execution::seq, raw_query, DocumentFilter(DocumentStatus::ACTUAL), cursor, page_size);
+}
+
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter, const SearchCursor& cursor, size_t page_size) const {
+    return FindTopDocuments<Scoring>(std::execution::seq, raw_query, document_filter, cursor, page_size);
+}
+
+template <typename Scoring, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter, const SearchCursor& cursor, size_t page_size) const {
+    const ResolvedFilter filter = ResolveFilter(document_filter);
+    return FindTopDocumentsByIdFilter<Scoring>(policy, raw_query, [&filter](int document_id) {
+        return filter.Contains(document_id);
+        }, [&cursor, page_size](std::vector<Document>& documents) {
+            SelectPage(documents, cursor, page_size);
         });
+}
+
+template <typename Scoring>
+PartialSearchResult SearchServer::FindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter, const QueryBudget& budget) const {
+    return FindTopDocuments<Scoring>(std::execution::seq, raw_query, document_filter, budget);
+}
+
+template <typename Scoring, typename ExecutionPolicy>
+PartialSearchResult SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter, const QueryBudget& budget) const {
+    const ResolvedFilter filter = ResolveFilter(document_filter);
+    QueryBudgetTracker tracker(budget);
+    PartialSearchResult result;
+    result.documents = FindTopDocumentsByIdFilter<Scoring>(policy, raw_query, [&filter](int document_id) {
+        return filter.Contains(document_id);
+        }, [](std::vector<Document>& documents) {
+            SelectTopDocuments(documents, MAX_RESULT_DOCUMENT_COUNT);
+        }, nullptr, &tracker, QueryMatchMode::ANY, &document_filter);
+    result.partial = tracker.IsExhausted();
+    result.postings_visited = tracker.GetPostingsVisited();
+    return result;
+}
+
+template <typename Scoring>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter, QueryMatchMode match_mode) const {
+    return FindTopDocuments<Scoring>(std::execution::seq, raw_query, document_filter, match_mode);
+}
+
+template <typename Scoring, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter, QueryMatchMode match_mode) const {
+    const ResolvedFilter filter = ResolveFilter(document_filter);
+    return FindTopDocumentsByIdFilter<Scoring>(policy, raw_query, [&filter](int document_id) {
+        return filter.Contains(document_id);
+        }, [](std::vector<Document>& documents) {
+            SelectTopDocuments(documents, MAX_RESULT_DOCUMENT_COUNT);
+        }, nullptr, nullptr, match_mode, &document_filter);
+}
+
+template <typename Scoring>
+std::vector<Document> SearchServer::ProfileFindTopDocuments(const std::string_view raw_query, const DocumentFilter& document_filter, QueryProfile& profile) const {
+    return ProfileFindTopDocuments<Scoring>(std::execution::seq, raw_query, document_filter, profile);
+}
+
+template <typename Scoring, typename ExecutionPolicy>
+std::vector<Document> SearchServer::ProfileFindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, const DocumentFilter& document_filter, QueryProfile& profile) const {
+    const ResolvedFilter filter = ResolveFilter(document_filter);
+    return FindTopDocumentsByIdFilter<Scoring>(policy, raw_query, [&filter](int document_id) {
+        return filter.Contains(document_id);
+        }, [](std::vector<Document>& documents) {
+            SelectTopDocuments(documents, MAX_RESULT_DOCUMENT_COUNT);
+        }, &profile, nullptr, QueryMatchMode::ANY, &document_filter);
+}
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template <typename Scoring, typename ExecutionPolicy, typename DocumentIdFilter, typename DocumentSelector>
+std::vector<Document> SearchServer::FindTopDocumentsByIdFilter(ExecutionPolicy& policy, const std::string_view raw_query, DocumentIdFilter document_id_filter, DocumentSelector select_documents,
+    QueryProfile* profile, QueryBudgetTracker* budget, QueryMatchMode match_mode, const DocumentFilter* champion_filter) const {
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point stage_start;
+    if (profile) {
+        stage_start = Clock::now();
+    }
+    auto query = ParseQuery(raw_query);
+    query.match_mode = match_mode;
+    if (match_mode == QueryMatchMode::ANY) {
+        ExpandPrefixWords(query);
+        if (fuzzy_term_index_) {
+            ExpandFuzzyWords(query);
+        }
+    }
+    if (profile) {
+        *profile = QueryProfile();
+        profile->parse_time = Clock::now() - stage_start;
+        profile->execution_path = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy> ? "par" : "seq";
+        profile->index = "inverted";
+        StartQueryProfile<Scoring>(query, *profile);
+        stage_start = Clock::now();
+    }
+    if constexpr (std::is_same_v<Scoring, TfIdfScoring>) {
+        if (champion_filter) {
+            if (auto documents = FindChampionDocuments(query, *champion_filter)) {
+                if (profile) {
+                    profile->index = "champion";
+                    profile->score_time = Clock::now() - stage_start;
+                    profile->result_count = documents->size();
+                }
+                return std::move(*documents);
+            }
+        }
     }
 
+    std::vector<Document> matched_documents;
+    {
+        MEASURE_STAGE(MetricStage::SCORING);
+        matched_documents = FindAllDocuments<Scoring>(policy, query, document_id_filter, select_documents, profile, budget);
+    }
+    if (profile) {
+        const auto now = Clock::now();
+        profile->score_time = now - stage_start;
+        stage_start = now;
+    }
+    {
+        MEASURE_STAGE(MetricStage::TOP_K);
+        select_documents(matched_documents);
+    }
+    if (profile) {
+        profile->select_time = Clock::now() - stage_start;
+        profile->result_count = matched_documents.size();
+    }
     return matched_documents;
 }
 
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
+template <typename Scoring>
+void SearchServer::StartQueryProfile(const Query& query, QueryProfile& profile) const {
+    const auto add_terms = [this, &profile](const std::vector<std::string_view>& words, bool is_minus) {
+        for (const auto word : words) {
+            TermProfile term;
+            term.word = std::string(word);
+            term.is_minus = is_minus;
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end()) {
+                term.posting_length = it->second.size();
+                term.idf = Scoring::ComputeTermWeight(GetDocumentCount(), static_cast<int>(it->second.size()));
+            }
+            profile.terms.push_back(std::move(term));
+        }
+    };
+    add_terms(query.plus_words, false);
+    add_terms(query.minus_words, true);
+}
+
+template<typename Scoring, typename DocumentIdFilter>
+std::vector<Document> SearchServer::FindDocumentsInRange(const Query& query, DocumentIdRange range, DocumentIdFilter document_id_filter, QueryProfile* profile,
+    QueryBudgetTracker* budget) const {
+    if (query.match_mode == QueryMatchMode::ALL) {
+        return FindConjunctiveDocumentsInRange<Scoring>(query, range, document_id_filter, profile);
+    }
+    if constexpr (Scoring::USES_IMPACT_INDEX) {
+        if (!impact_index_.Empty() && query.plus_word_weights.empty()) {
+            return FindDocumentsByImpactInRange(query, range, document_id_filter, profile);
+        }
+    }
+
     std::map<int, double> document_to_relevance;
+    const double average_word_count = Scoring::USES_DOCUMENT_LENGTH ? GetAverageWordCount() : 0.0;
+    [[maybe_unused]] uint64_t postings_scanned = 0;
 
-    for (const auto& word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    // С бюджетом слова обрабатываются от редких к частым: редкие слова весомее, и неполная выдача
+    // успевает учесть их целиком. Бюджет списывается порциями, вне порции проверка - одно сравнение
+    std::vector<size_t> word_order;
+    uint64_t budget_allowance = 0;
+    uint64_t budget_used = 0;
+    if (budget) {
+        word_order.resize(query.plus_words.size());
+        std::iota(word_order.begin(), word_order.end(), 0);
+        const auto get_posting_length = [this](std::string_view word) {
+            const auto word_it = word_to_document_freqs_.find(word);
+            return word_it == word_to_document_freqs_.end() ? size_t{ 0 } : word_it->second.size();
+        };
+        std::stable_sort(word_order.begin(), word_order.end(), [&query, &get_posting_length](size_t lhs, size_t rhs) {
+            return get_posting_length(query.plus_words[lhs]) < get_posting_length(query.plus_words[rhs]);
+            });
+        budget_allowance = budget->Consume(0);
+    }
+    bool budget_exhausted = budget && budget_allowance == 0;
+
+    for (size_t position = 0; position < query.plus_words.size() && !budget_exhausted; ++position) {
+        const size_t word_index = budget ? word_order[position] : position;
+        const auto word_it = word_to_document_freqs_.find(query.plus_words[word_index]);
+        if (word_it == word_to_document_freqs_.end()) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_id_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_id_data.status, document_id_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        const auto& id_freqs = word_it->second;
+        double term_weight = Scoring::ComputeTermWeight(GetDocumentCount(), static_cast<int>(id_freqs.size()));
+        if (!query.plus_word_weights.empty()) {
+            term_weight *= query.plus_word_weights[word_index];
+        }
+        const uint64_t word_postings_start = postings_scanned;
+        size_t skipped_by_filter = 0;
+        for (auto it = id_freqs.lower_bound(range.first); it != id_freqs.end() && it->first <= range.last; ++it) {
+            if (budget && budget_used == budget_allowance) {
+                budget_allowance = budget->Consume(budget_used);
+                budget_used = 0;
+                if (budget_allowance == 0) {
+                    budget_exhausted = true;
+                    break;
+                }
+            }
+            ++budget_used;
+            ++postings_scanned;
+            const auto& [document_id, term_freq] = *it;
+            if (!document_id_filter(document_id)) {
+                ++skipped_by_filter;
+                continue;
+            }
+            if constexpr (Scoring::USES_DOCUMENT_LENGTH) {
+                const double word_count = documents_.at(document_id).word_count;
+                document_to_relevance[document_id] += Scoring::Score(term_freq, term_weight, word_count, average_word_count);
+            }
+            else {
+                document_to_relevance[document_id] += Scoring::Score(term_freq, term_weight, 0.0, 0.0);
             }
         }
+        if (profile) {
+            TermProfile& term = profile->terms[word_index];
+            term.postings_visited += postings_scanned - word_postings_start;
+            term.skipped_by_filter += skipped_by_filter;
+        }
+    }
+    if (budget) {
+        budget->Record(budget_used);
+    }
+    if (profile) {
+        profile->accumulator_size += document_to_relevance.size();
     }
 
-    for (const auto& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    for (size_t word_index = 0; word_index < query.minus_words.size(); ++word_index) {
+        const auto word_it = word_to_document_freqs_.find(query.minus_words[word_index]);
+        if (word_it == word_to_document_freqs_.end()) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        const auto& id_freqs = word_it->second;
+        size_t postings_visited = 0;
+        size_t skipped_by_minus = 0;
+        for (auto it = id_freqs.lower_bound(range.first); it != id_freqs.end() && it->first <= range.last; ++it) {
+            ++postings_visited;
+            skipped_by_minus += document_to_relevance.erase(it->first);
+        }
+        if (profile) {
+            TermProfile& term = profile->terms[query.plus_words.size() + word_index];
+            term.postings_visited += postings_visited;
+            term.skipped_by_minus += skipped_by_minus;
         }
     }
 
+    ADD_TO_COUNTER(MetricCounter::POSTINGS_SCANNED, postings_scanned);
+    ADD_TO_COUNTER(MetricCounter::DOCUMENTS_SCORED, document_to_relevance.size());
+
     std::vector<Document> matched_documents;
+    matched_documents.reserve(document_to_relevance.size());
     for (const auto& [document_id, relevance] : document_to_relevance) {
         matched_documents.push_back(
             { document_id, relevance, documents_.at(document_id).rating });
@@ -191,45 +873,169 @@ std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Documen
     return matched_documents;
 }
 
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(query, document_predicate);
-}
+template<typename Scoring, typename DocumentIdFilter>
+std::vector<Document> SearchServer::FindConjunctiveDocumentsInRange(const Query& query, DocumentIdRange range, DocumentIdFilter document_id_filter, QueryProfile* profile) const {
+    std::vector<Document> matched_documents;
+    std::vector<PostingCursor> plus_cursors;
+    plus_cursors.reserve(query.plus_words.size());
+    for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+        const auto word_it = word_to_document_freqs_.find(query.plus_words[word_index]);
+        if (word_it == word_to_document_freqs_.end()) {
+            return matched_documents; // Слово не встречается ни в одном документе
+        }
+        const auto& id_freqs = word_it->second;
+        const double term_weight = Scoring::ComputeTermWeight(GetDocumentCount(), static_cast<int>(id_freqs.size()));
+        plus_cursors.push_back({ &id_freqs, id_freqs.lower_bound(range.first), term_weight, word_index });
+    }
+    if (plus_cursors.empty()) {
+        return matched_documents;
+    }
+    std::vector<PostingCursor> minus_cursors;
+    for (size_t word_index = 0; word_index < query.minus_words.size(); ++word_index) {
+        const auto word_it = word_to_document_freqs_.find(query.minus_words[word_index]);
+        if (word_it != word_to_document_freqs_.end()) {
+            minus_cursors.push_back({ &word_it->second, word_it->second.lower_bound(range.first), 0.0, query.plus_words.size() + word_index });
+        }
+    }
 
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(std::max(static_cast<int>(query.plus_words.size()), 100));
+    std::sort(plus_cursors.begin(), plus_cursors.end(), [](const PostingCursor& lhs, const PostingCursor& rhs) {
+        return lhs.id_freqs->size() < rhs.id_freqs->size();
+        });
+    // Вклады слов складываются в порядке слов запроса, как при QueryMatchMode::ANY
+    std::vector<const PostingCursor*> cursors_by_word(plus_cursors.size());
+    for (const PostingCursor& cursor : plus_cursors) {
+        cursors_by_word[cursor.word_index] = &cursor;
+    }
+    const double average_word_count = Scoring::USES_DOCUMENT_LENGTH ? GetAverageWordCount() : 0.0;
 
-    std::for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [&document_to_relevance, this, &document_predicate](const auto& word) {
-        if (word_to_document_freqs_.count(word) != 0) {
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto& document_id_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_id_data.status, document_id_data.rating)) {
-                    document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-                }
+    // Кандидат берётся из самого редкого списка. Если в следующем списке его нет, кандидатом становится
+    // найденный там больший ID, и редкий список догоняет его одним сдвигом
+    PostingCursor& rarest = plus_cursors.front();
+    int candidate = range.first;
+    while (rarest.Seek(candidate) && rarest.it->first <= range.last) {
+        candidate = rarest.it->first;
+        size_t cursor_index = 1;
+        for (; cursor_index < plus_cursors.size(); ++cursor_index) {
+            PostingCursor& cursor = plus_cursors[cursor_index];
+            if (!cursor.Seek(candidate) || cursor.it->first != candidate) {
+                break;
             }
         }
-        });
+        if (cursor_index < plus_cursors.size()) {
+            if (plus_cursors[cursor_index].it == plus_cursors[cursor_index].id_freqs->end()) {
+                break; // Список исчерпан, дальше пересечение пусто
+            }
+            candidate = plus_cursors[cursor_index].it->first;
+            continue;
+        }
 
+        const bool excluded = std::any_of(minus_cursors.begin(), minus_cursors.end(), [candidate](PostingCursor& cursor) {
+            return cursor.Seek(candidate) && cursor.it->first == candidate;
+            });
+        if (!excluded && document_id_filter(candidate)) {
+            const int document_id = candidate;
+            double relevance = 0.0;
+            const DocumentData& document_data = documents_.at(document_id);
+            for (const PostingCursor* cursor : cursors_by_word) {
+                if constexpr (Scoring::USES_DOCUMENT_LENGTH) {
+                    relevance += Scoring::Score(cursor->it->second, cursor->term_weight, document_data.word_count, average_word_count);
+                }
+                else {
+                    relevance += Scoring::Score(cursor->it->second, cursor->term_weight, 0.0, 0.0);
+                }
+            }
+            matched_documents.push_back({ document_id, relevance, document_data.rating });
+        }
+        if (candidate == range.last) {
+            break;
+        }
+        ++candidate;
+    }
 
-    std::for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [&document_to_relevance, this](const auto& word) {
-        if (word_to_document_freqs_.count(word) != 0) {
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.Erase(document_id);
+    uint64_t postings_visited = 0;
+    for (const auto* cursors : { &plus_cursors, &minus_cursors }) {
+        for (const PostingCursor& cursor : *cursors) {
+            postings_visited += cursor.postings_visited;
+            if (profile) {
+                profile->terms[cursor.word_index].postings_visited += cursor.postings_visited;
             }
         }
-        });
+    }
+    if (profile) {
+        profile->accumulator_size += matched_documents.size();
+    }
+    ADD_TO_COUNTER(MetricCounter::POSTINGS_SCANNED, postings_visited);
+    ADD_TO_COUNTER(MetricCounter::DOCUMENTS_SCORED, matched_documents.size());
+    return matched_documents;
+}
+
+template<typename DocumentIdFilter>
+std::vector<Document> SearchServer::FindDocumentsByImpactInRange(const Query& query, DocumentIdRange range, DocumentIdFilter document_id_filter, QueryProfile* profile) const {
+    auto scores = impact_index_.Accumulate(query.plus_words, range.first, range.last);
+    if (profile) {
+        profile->index = "impact";
+        profile->accumulator_size += scores.size();
+    }
+    impact_index_.Exclude(query.minus_words, scores);
 
+    ADD_TO_COUNTER(MetricCounter::DOCUMENTS_SCORED, scores.size());
+
+    const double scale = impact_index_.GetScale();
     std::vector<Document> matched_documents;
-    std::map<int, double> result = document_to_relevance.BuildOrdinaryMap();
-    matched_documents.reserve(result.size());
+    matched_documents.reserve(scores.size());
+    for (const auto& [document_id, score] : scores) {
+        if (document_id_filter(document_id)) {
+            matched_documents.push_back({ document_id, score * scale, documents_.at(document_id).rating });
+        }
+    }
+    return matched_documents;
+}
 
-    std::for_each(std::execution::par, result.begin(), result.end(), [&matched_documents, this](const auto& doc) {
-        matched_documents.push_back(
-            { doc.first, doc.second, documents_.at(doc.first).rating });
+template<typename Scoring, typename DocumentIdFilter>
+std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentIdFilter document_id_filter, QueryProfile* profile, QueryBudgetTracker* budget) const {
+    return FindDocumentsInRange<Scoring>(query, ALL_DOCUMENT_IDS, document_id_filter, profile, budget);
+}
+
+template<typename Scoring, typename DocumentIdFilter, typename DocumentSelector>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentIdFilter document_id_filter, DocumentSelector,
+    QueryProfile* profile, QueryBudgetTracker* budget) const {
+    return FindAllDocuments<Scoring>(query, document_id_filter, profile, budget);
+}
+
+// Пространство ID документов делится на диапазоны, каждый поток обрабатывает все слова запроса
+// в своём диапазоне без общих данных. Из каждого диапазона возвращается только отобранная select_documents
+// часть выдачи, поэтому результат годится лишь для повторного отбора той же функцией.
+template<typename Scoring, typename DocumentIdFilter, typename DocumentSelector>
+std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentIdFilter document_id_filter, DocumentSelector select_documents,
+    QueryProfile* profile, QueryBudgetTracker* budget) const {
+    const auto ranges = SplitDocumentIdRanges();
+    std::vector<std::vector<Document>> range_documents(ranges.size());
+    // Каждый диапазон собирает счётчики в свою копию профиля, копии суммируются после обработки
+    QueryProfile initial_range_profile;
+    if (profile) {
+        initial_range_profile.terms = profile->terms;
+    }
+    std::vector<QueryProfile> range_profiles(profile ? ranges.size() : 0, initial_range_profile);
+
+    std::vector<size_t> range_indexes(ranges.size());
+    std::iota(range_indexes.begin(), range_indexes.end(), 0);
+
+    std::transform(std::execution::par, range_indexes.begin(), range_indexes.end(), range_documents.begin(), [this, &query, &document_id_filter, &select_documents, &ranges, &range_profiles, budget](const size_t index) {
+        QueryProfile* range_profile = range_profiles.empty() ? nullptr : &range_profiles[index];
+        auto documents = FindDocumentsInRange<Scoring>(query, ranges[index], document_id_filter, range_profile, budget);
+        select_documents(documents);
+        return documents;
         });
+    if (profile) {
+        for (const QueryProfile& range_profile : range_profiles) {
+            profile->AddCounters(range_profile);
+        }
+    }
 
+    std::vector<Document> matched_documents;
+    for (auto& documents : range_documents) {
+        std::move(documents.begin(), documents.end(), std::back_inserter(matched_documents));
+    }
     return matched_documents;
 }
 
@@ -0,0 +1,278 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+
+namespace {
+
+void AppendVarint(std::pmr::string& output, uint32_t value) {
+    while (value >= 0x80) {
+        output.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<char>(value));
+}
+
+uint32_t ReadVarint(const std::pmr::string& input, size_t& offset) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const auto byte = static_cast<unsigned char>(input[offset++]);
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
+
+// Последовательное чтение слов блока: каждое следующее слово восстанавливается из предыдущего
+class BlockReader {
+public:
+    BlockReader(const std::pmr::string& data, size_t offset)
+        : data_(data)
+        , offset_(offset) {
+    }
+
+    // Читает следующее слово, его ID и вес
+    void Next() {
+        const uint32_t shared_length = ReadVarint(data_, offset_);
+        const uint32_t suffix_length = ReadVarint(data_, offset_);
+        term_.resize(shared_length);
+        term_.append(data_, offset_, suffix_length);
+        offset_ += suffix_length;
+        term_id_ = static_cast<int>(ReadVarint(data_, offset_));
+        weight_ = ReadVarint(data_, offset_);
+    }
+
+    const std::string& GetTerm() const {
+        return term_;
+    }
+
+    int GetTermId() const {
+        return term_id_;
+    }
+
+    uint32_t GetWeight() const {
+        return weight_;
+    }
+
+private:
+    const std::pmr::string& data_;
+    size_t offset_;
+    std::string term_;
+    int term_id_ = 0;
+    uint32_t weight_ = 0;
+};
+
+}
+
+TermDictionary::TermDictionary(std::pmr::memory_resource* memory_resource)
+    : data_(memory_resource)
+    , block_offsets_(memory_resource)
+    , block_max_weights_(memory_resource) {
+}
+
+void TermDictionary::Build(const std::vector<Entry>& entries) {
+    Clear();
+    std::string_view previous;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const auto [term, term_id, weight] = entries[i];
+        if (i > 0 && term <= previous) {
+            throw std::invalid_argument("dictionary terms must be sorted and unique");
+        }
+        size_t shared_length = 0;
+        if (i % BLOCK_SIZE == 0) {
+            block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+            block_max_weights_.push_back(weight);
+        }
+        else {
+            const size_t max_shared_length = std::min(term.size(), previous.size());
+            while (shared_length < max_shared_length && term[shared_length] == previous[shared_length]) {
+                ++shared_length;
+            }
+        }
+        AppendVarint(data_, static_cast<uint32_t>(shared_length));
+        AppendVarint(data_, static_cast<uint32_t>(term.size() - shared_length));
+        data_.append(term.substr(shared_length));
+        AppendVarint(data_, static_cast<uint32_t>(term_id));
+        AppendVarint(data_, weight);
+        block_max_weights_.back() = std::max(block_max_weights_.back(), weight);
+        previous = term;
+    }
+    data_.shrink_to_fit();
+    block_offsets_.shrink_to_fit();
+    block_max_weights_.shrink_to_fit();
+    term_count_ = entries.size();
+    built_ = true;
+}
+
+void TermDictionary::Clear() {
+    data_.clear();
+    data_.shrink_to_fit();
+    block_offsets_.clear();
+    block_offsets_.shrink_to_fit();
+    block_max_weights_.clear();
+    block_max_weights_.shrink_to_fit();
+    term_count_ = 0;
+    built_ = false;
+}
+
+bool TermDictionary::Empty() const {
+    return !built_;
+}
+
+size_t TermDictionary::GetTermCount() const {
+    return term_count_;
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    return data_.capacity() + (block_offsets_.capacity() + block_max_weights_.capacity()) * sizeof(uint32_t);
+}
+
+std::string_view TermDictionary::GetBlockHead(size_t block_index) const {
+    size_t offset = block_offsets_[block_index];
+    ReadVarint(data_, offset); // Длина общего префикса первого слова блока равна нулю
+    const uint32_t length = ReadVarint(data_, offset);
+    return std::string_view(data_).substr(offset, length);
+}
+
+size_t TermDictionary::FindBlock(std::string_view term) const {
+    // Первый блок, начинающийся со слова больше term; искомое слово - в предыдущем
+    size_t first = 0;
+    size_t last = block_offsets_.size();
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        if (GetBlockHead(middle) <= term) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    return first == 0 ? 0 : first - 1;
+}
+
+size_t TermDictionary::FindPrefixEndBlock(std::string_view prefix, size_t first_block) const {
+    // Первые слова блоков отсортированы, поэтому блоки с первым словом меньше prefix или с prefix идут подряд
+    size_t first = first_block + 1;
+    size_t last = block_offsets_.size();
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        const std::string_view head = GetBlockHead(middle);
+        if (head < prefix || head.substr(0, prefix.size()) == prefix) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+std::optional<int> TermDictionary::Find(std::string_view term) const {
+    if (block_offsets_.empty()) {
+        return std::nullopt;
+    }
+    const size_t block_index = FindBlock(term);
+    BlockReader reader(data_, block_offsets_[block_index]);
+    const size_t block_end = std::min(term_count_, (block_index + 1) * BLOCK_SIZE);
+    for (size_t i = block_index * BLOCK_SIZE; i < block_end; ++i) {
+        reader.Next();
+        if (reader.GetTerm() >= term) {
+            if (reader.GetTerm() == term) {
+                return reader.GetTermId();
+            }
+            break;
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<int> TermDictionary::FindPrefix(std::string_view prefix) const {
+    std::vector<int> term_ids;
+    if (block_offsets_.empty()) {
+        return term_ids;
+    }
+    size_t block_index = FindBlock(prefix);
+    for (size_t i = block_index * BLOCK_SIZE; i < term_count_; ++block_index) {
+        BlockReader reader(data_, block_offsets_[block_index]);
+        const size_t block_end = std::min(term_count_, (block_index + 1) * BLOCK_SIZE);
+        for (; i < block_end; ++i) {
+            reader.Next();
+            const std::string_view term = reader.GetTerm();
+            if (term.substr(0, prefix.size()) == prefix) {
+                term_ids.push_back(reader.GetTermId());
+            }
+            else if (term > prefix) {
+                return term_ids;
+            }
+        }
+    }
+    return term_ids;
+}
+
+std::vector<int> TermDictionary::FindTopPrefix(std::string_view prefix, size_t limit) const {
+    if (block_offsets_.empty() || limit == 0) {
+        return {};
+    }
+    const size_t first_block = FindBlock(prefix);
+    const size_t last_block = FindPrefixEndBlock(prefix, first_block);
+
+    // Кандидат - вес и позиция слова в словаре: тяжелее, а при равном весе раньше - лучше.
+    // Граница блока сравнивается с отобранными словами как кандидат с весом блока и позицией его первого слова
+    using Candidate = std::tuple<uint32_t, size_t, int>;
+    const auto is_better = [](uint32_t lhs_weight, size_t lhs_position, uint32_t rhs_weight, size_t rhs_position) {
+        return lhs_weight != rhs_weight ? lhs_weight > rhs_weight : lhs_position < rhs_position;
+    };
+    const auto candidate_is_better = [&is_better](const Candidate& lhs, const Candidate& rhs) {
+        return is_better(std::get<0>(lhs), std::get<1>(lhs), std::get<0>(rhs), std::get<1>(rhs));
+    };
+
+    // Куча блоков с лучшей границей на вершине и куча отобранных слов с худшим на вершине
+    std::vector<std::pair<uint32_t, size_t>> blocks;
+    blocks.reserve(last_block - first_block);
+    for (size_t block_index = first_block; block_index < last_block; ++block_index) {
+        blocks.emplace_back(block_max_weights_[block_index], block_index);
+    }
+    const auto block_is_worse = [&is_better](const auto& lhs, const auto& rhs) {
+        return is_better(rhs.first, rhs.second, lhs.first, lhs.second);
+    };
+    std::make_heap(blocks.begin(), blocks.end(), block_is_worse);
+    std::vector<Candidate> top;
+    top.reserve(limit);
+
+    while (!blocks.empty()) {
+        std::pop_heap(blocks.begin(), blocks.end(), block_is_worse);
+        const auto [max_weight, block_index] = blocks.back();
+        blocks.pop_back();
+        if (top.size() == limit && !is_better(max_weight, block_index * BLOCK_SIZE, std::get<0>(top.front()), std::get<1>(top.front()))) {
+            break; // Остальные блоки не лучше этого, а он не лучше худшего отобранного слова
+        }
+        BlockReader reader(data_, block_offsets_[block_index]);
+        const size_t block_end = std::min(term_count_, (block_index + 1) * BLOCK_SIZE);
+        for (size_t i = block_index * BLOCK_SIZE; i < block_end; ++i) {
+            reader.Next();
+            if (reader.GetTerm().compare(0, prefix.size(), prefix) != 0) {
+                continue;
+            }
+            Candidate candidate(reader.GetWeight(), i, reader.GetTermId());
+            if (top.size() < limit) {
+                top.push_back(candidate);
+                std::push_heap(top.begin(), top.end(), candidate_is_better);
+            }
+            else if (candidate_is_better(candidate, top.front())) {
+                std::pop_heap(top.begin(), top.end(), candidate_is_better);
+                top.back() = candidate;
+                std::push_heap(top.begin(), top.end(), candidate_is_better);
+            }
+        }
+    }
+
+    std::sort_heap(top.begin(), top.end(), candidate_is_better);
+    std::vector<int> term_ids;
+    term_ids.reserve(top.size());
+    for (const auto& candidate : top) {
+        term_ids.push_back(std::get<2>(candidate));
+    }
+    return term_ids;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Неизменяемый отсортированный словарь слово - ID слова с фронтальным кодированием. Слова хранятся блоками
+// по BLOCK_SIZE в одном буфере: для каждого слова - длина общего с предыдущим словом блока префикса,
+// остаток, ID и вес, первое слово блока записывается целиком. Поиск - двоичный поиск по первым словам блоков
+// и последовательное декодирование одного блока, перечисление по префиксу продолжает декодирование.
+// Для каждого блока хранится наибольший вес его слов: выбор самых тяжёлых слов с префиксом
+// декодирует блоки по убыванию этой границы и не трогает блоки, которые не могут попасть в выдачу
+class TermDictionary {
+public:
+    struct Entry {
+        std::string_view term;
+        int term_id;
+        uint32_t weight;
+    };
+
+    explicit TermDictionary(std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource());
+
+    // entries отсортированы по слову без повторов
+    void Build(const std::vector<Entry>& entries);
+
+    void Clear();
+
+    bool Empty() const;
+
+    size_t GetTermCount() const;
+
+    // Байт, занятых словарём
+    size_t GetMemoryUsage() const;
+
+    std::optional<int> Find(std::string_view term) const;
+
+    // ID слов, начинающихся с prefix, в порядке слов
+    std::vector<int> FindPrefix(std::string_view prefix) const;
+
+    // ID не более limit слов с prefix с наибольшим весом, при равном весе - первых по порядку слов.
+    // Результат упорядочен от тяжёлых слов к лёгким
+    std::vector<int> FindTopPrefix(std::string_view prefix, size_t limit) const;
+
+private:
+    static const size_t BLOCK_SIZE = 16;
+
+    std::pmr::string data_;
+    std::pmr::vector<uint32_t> block_offsets_;
+    std::pmr::vector<uint32_t> block_max_weights_;
+    size_t term_count_ = 0;
+    bool built_ = false;
+
+    // Первое слово блока
+    std::string_view GetBlockHead(size_t block_index) const;
+
+    // Индекс блока, в котором может быть первое слово не меньше term
+    size_t FindBlock(std::string_view term) const;
+
+    // Индекс первого блока после first_block, все слова которого больше слов с prefix
+    size_t FindPrefixEndBlock(std::string_view prefix, size_t first_block) const;
+};
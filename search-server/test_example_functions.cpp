@@ -2,6 +2,18 @@
 #include "search_server.h"
 #include "remove_duplicates.h"
 #include "process_queries.h"
+#include "document_bitmap.h"
+#include "paginator.h"
+#include "metrics.h"
+#include "async_search.h"
+#include "write_ahead_log.h"
+#include "query_statistics.h"
+#include "request_queue.h"
+#include "term_dictionary.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
 
 using namespace std::literals;
 
@@ -378,6 +390,1268 @@ void TestProcessQueriesJoined() {
     }
 }
 
+void TestParallelFindTopDocuments() {
+    SearchServer search_server("and with"s);
+    const std::vector<std::string> texts = {
+        "funny pet and nasty rat"s,
+        "funny pet with curly hair"s,
+        "funny pet and not very nasty rat"s,
+        "pet with rat and rat and rat"s,
+        "nasty rat with curly hair"s,
+    };
+    for (int id = 0; id < 500; ++id) {
+        search_server.AddDocument(id * 7, texts[id % texts.size()], DocumentStatus::ACTUAL, { id % 11 });
+    }
+    for (const std::string& query : { "rat"s, "curly nasty -not"s, "funny pet hair"s, "dog"s }) {
+        const auto seq_documents = search_server.FindTopDocuments(std::execution::seq, query);
+        const auto par_documents = search_server.FindTopDocuments(std::execution::par, query);
+        ASSERT_EQUAL(seq_documents.size(), par_documents.size());
+        for (size_t i = 0; i < seq_documents.size(); ++i) {
+            ASSERT_EQUAL(seq_documents[i].rating, par_documents[i].rating);
+            ASSERT(std::abs(seq_documents[i].relevance - par_documents[i].relevance) < 1e-9);
+        }
+    }
+}
+
+void TestMatchDocuments() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+    search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    const std::vector<int> document_ids = { 3, 1, 2 };
+    for (const auto& result : { search_server.MatchDocuments("curly rat funny -pet"s, document_ids),
+                                search_server.MatchDocuments(std::execution::par, "curly rat funny -pet"s, document_ids) }) {
+        ASSERT_EQUAL(result.size(), 3);
+        const std::vector<std::string_view> expected_words = { "curly"sv, "rat"sv };
+        ASSERT(std::get<0>(result[0]) == expected_words);
+        ASSERT(std::get<0>(result[1]).empty());
+        ASSERT(std::get<0>(result[2]).empty());
+        ASSERT(std::get<1>(result[2]) == DocumentStatus::BANNED);
+    }
+    for (const int document_id : document_ids) {
+        const auto [words, status] = search_server.MatchDocument("curly rat funny -pet"s, document_id);
+        ASSERT(words == std::get<0>(search_server.MatchDocuments("curly rat funny -pet"s, { document_id })[0]));
+    }
+    try {
+        search_server.MatchDocuments("curly"s, { 1, 4 });
+        ASSERT_HINT(false, "Unknown document id must be rejected"s);
+    }
+    catch (const std::out_of_range&) {
+    }
+}
+
+void TestRemoveDocuments() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(4, "big dog"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.RemoveDocuments({ 1, 4 });
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+    ASSERT(search_server.FindTopDocuments("dog"s).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("rat"s).size(), 1);
+    ASSERT_EQUAL(search_server.FindTopDocuments("rat"s)[0].id, 3);
+    try {
+        search_server.RemoveDocuments({ 2, 5 });
+        ASSERT_HINT(false, "Unknown document id must be rejected"s);
+    }
+    catch (const std::out_of_range&) {
+    }
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+}
+
+void TestFindNearDuplicates() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat with curly hair and big eyes"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "funny pet and nasty rat with curly hair and big ears"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(3, "white cat and yellow hat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(4, "funny pet and nasty rat with curly hair and big eyes"s, DocumentStatus::ACTUAL, { 1, 2 });
+    const auto near_duplicates = FindNearDuplicates(search_server, 0.75);
+    // Документы 2 и 4 сравниваются с лидером компоненты - документом 1
+    ASSERT_EQUAL(near_duplicates.size(), 2);
+    ASSERT_EQUAL(near_duplicates[0].original_id, 1);
+    ASSERT_EQUAL(near_duplicates[0].duplicate_id, 2);
+    ASSERT(std::abs(near_duplicates[0].similarity - 7.0 / 9.0) < 1e-9);
+    ASSERT_EQUAL(near_duplicates[1].original_id, 1);
+    ASSERT_EQUAL(near_duplicates[1].duplicate_id, 4);
+    ASSERT_EQUAL(near_duplicates[1].similarity, 1.0);
+    RemoveNearDuplicates(search_server, 0.75);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+    ASSERT(search_server.FindTopDocuments("yellow"s).size() == 1);
+
+    {
+        // Документ 1 попадает в корзину с 2 и 3, но не похож на них: 3 находится как дубликат 2, ставшего вторым лидером
+        SearchServer server("and with"s);
+        server.AddDocument(1, "funny pet and nasty rat with curly hair and big eyes"s, DocumentStatus::ACTUAL, { 1 });
+        server.AddDocument(2, "funny pet and nasty rat with curly hair and small eyes"s, DocumentStatus::ACTUAL, { 1 });
+        server.AddDocument(3, "funny pet and nasty rat with curly hair and small eyes"s, DocumentStatus::ACTUAL, { 1 });
+        ResetMetrics();
+        const auto pairs = FindNearDuplicates(server, 0.95);
+        ASSERT_EQUAL(TakeMetricsSnapshot()[MetricCounter::NEAR_DUPLICATE_CHECKS], 3u);
+        ASSERT_EQUAL(pairs.size(), 1u);
+        ASSERT_EQUAL(pairs[0].original_id, 2);
+        ASSERT_EQUAL(pairs[0].duplicate_id, 3);
+    }
+
+    {
+        // Тысяча копий одной страницы лежат в одних корзинах, но сравниваются только с лидером
+        SearchServer server("and with"s);
+        const int copy_count = 1000;
+        for (int id = 0; id < copy_count; ++id) {
+            server.AddDocument(id, "the same crawled page about funny pets"s, DocumentStatus::ACTUAL, { 1 });
+        }
+        ResetMetrics();
+        const auto pairs = FindNearDuplicates(server);
+        ASSERT_EQUAL(pairs.size(), static_cast<size_t>(copy_count - 1));
+        ASSERT_EQUAL(TakeMetricsSnapshot()[MetricCounter::NEAR_DUPLICATE_CHECKS], static_cast<uint64_t>(copy_count - 1));
+    }
+}
+
+void TestDuplicatePolicy() {
+    {
+        SearchServer search_server("and with"s);
+        search_server.SetDuplicatePolicy(DuplicatePolicy::REJECT);
+        search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        try {
+            search_server.AddDocument(2, "rat nasty pet funny funny"s, DocumentStatus::ACTUAL, { 1, 2 });
+            ASSERT_HINT(false, "Duplicate document must be rejected"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        search_server.AddDocument(3, "funny pet with curly rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+        search_server.AddDocument(4, "funny pet"s, DocumentStatus::ACTUAL, { 1, 2 });
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 3);
+    }
+    {
+        SearchServer search_server("and with"s);
+        search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        search_server.SetDuplicatePolicy(DuplicatePolicy::ALIAS);
+        search_server.AddDocument(2, "rat nasty pet funny"s, DocumentStatus::ACTUAL, { 1, 2 });
+        search_server.AddDocument(3, "curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+        ASSERT_EQUAL(search_server.GetOriginalDocumentId(2), 1);
+        ASSERT_EQUAL(search_server.GetOriginalDocumentId(3), 3);
+        ASSERT_EQUAL(search_server.FindTopDocuments("rat"s).size(), 1);
+
+        search_server.RemoveDocument(1);
+        try {
+            search_server.GetOriginalDocumentId(2);
+            ASSERT_HINT(false, "Aliases must be removed with the original document"s);
+        }
+        catch (const std::out_of_range&) {
+        }
+        search_server.AddDocument(4, "funny rat pet nasty"s, DocumentStatus::ACTUAL, { 1, 2 });
+        ASSERT_EQUAL(search_server.GetOriginalDocumentId(4), 4);
+        search_server.AddDocument(5, "funny rat pet nasty"s, DocumentStatus::ACTUAL, { 1, 2 });
+        ASSERT_EQUAL(search_server.GetOriginalDocumentId(5), 4);
+        search_server.RemoveDocuments({ 5 });
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+    }
+}
+
+void TestDocumentBitmap() {
+    DocumentBitmap even;
+    DocumentBitmap small;
+    for (int id = 0; id < 200000; id += 2) {
+        even.Insert(id);
+    }
+    for (int id = 0; id < 100; ++id) {
+        small.Insert(id);
+    }
+    small.Insert(150001);
+    ASSERT_EQUAL(even.Count(), 100000);
+    ASSERT(even.Contains(131072) && !even.Contains(131073));
+
+    DocumentBitmap intersection = even;
+    intersection &= small;
+    ASSERT_EQUAL(intersection.Count(), 50);
+
+    DocumentBitmap united = small;
+    united |= even;
+    ASSERT_EQUAL(united.Count(), 100000 + 50 + 1);
+
+    DocumentBitmap difference = even;
+    difference -= small;
+    ASSERT_EQUAL(difference.Count(), 100000 - 50);
+
+    for (int id = 0; id < 200000; id += 4) {
+        even.Erase(id);
+    }
+    ASSERT_EQUAL(even.Count(), 50000);
+    std::vector<int> ids;
+    even.ForEach([&ids](int id) { ids.push_back(id); });
+    ASSERT_EQUAL(ids.size(), 50000);
+    ASSERT(std::is_sorted(ids.begin(), ids.end()) && ids.front() == 2 && ids.back() == 199998);
+
+    // Хранятся только непустые блоки, поэтому ID около INT_MAX не создаёт десятков тысяч пустых блоков
+    const int max_id = std::numeric_limits<int>::max();
+    DocumentBitmap far;
+    far.Insert(max_id);
+    far.Insert(max_id - 1);
+    far.Insert(5);
+    ASSERT_EQUAL(far.Count(), 3u);
+    ASSERT(far.Contains(max_id) && far.Contains(max_id - 1) && !far.Contains(max_id - 2) && !far.Contains(65541));
+    ids.clear();
+    far.ForEach([&ids](int id) { ids.push_back(id); });
+    ASSERT((ids == std::vector<int>{ 5, max_id - 1, max_id }));
+    ASSERT_EQUAL(far.CountIntersection(small), 1u);
+
+    DocumentBitmap far_union = small;
+    far_union |= far;
+    ASSERT_EQUAL(far_union.Count(), 101u + 2u);
+    far_union -= far;
+    ASSERT_EQUAL(far_union.Count(), 100u);
+    ASSERT(!far_union.Contains(max_id) && far_union.Contains(150001));
+
+    DocumentBitmap far_intersection = far;
+    far_intersection &= small;
+    ASSERT_EQUAL(far_intersection.Count(), 1u);
+    far_intersection.Erase(5);
+    ASSERT(far_intersection.Empty());
+    far.Erase(max_id);
+    far.Erase(max_id - 1);
+    ASSERT_EQUAL(far.Count(), 1u);
+}
+
+void TestFiltrationDocumentFilter() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 2 });
+    search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(4, "funny rat"s, DocumentStatus::IRRELEVANT, { 5 });
+
+    const auto actual = search_server.FindTopDocuments("funny rat"s, DocumentFilter(DocumentStatus::ACTUAL));
+    ASSERT_EQUAL(actual.size(), 2);
+
+    const auto rated = search_server.FindTopDocuments("funny rat"s, DocumentFilter(DocumentStatus::ACTUAL).WithRatingAtLeast(5));
+    ASSERT_EQUAL(rated.size(), 1);
+    ASSERT_EQUAL(rated[0].id, 1);
+
+    const auto any_status = search_server.FindTopDocuments(std::execution::par, "funny rat"s, DocumentFilter().WithRatingAtLeast(2).WithRatingAtMost(5));
+    ASSERT_EQUAL(any_status.size(), 2);
+
+    const auto statuses = search_server.FindTopDocuments("funny rat"s, DocumentFilter(DocumentStatus::BANNED).WithStatus(DocumentStatus::IRRELEVANT));
+    ASSERT_EQUAL(statuses.size(), 2);
+
+    // Рейтингов в диапазоне больше, чем проверяется по картам: рейтинг кандидата берётся из столбца рейтингов
+    for (int id = 10; id < 16; ++id) {
+        search_server.AddDocument(id, "funny hamster"s, DocumentStatus::ACTUAL, { id });
+    }
+    const DocumentFilter wide_range = DocumentFilter(DocumentStatus::ACTUAL).WithStatus(DocumentStatus::IRRELEVANT).WithRatingAtLeast(5).WithRatingAtMost(13);
+    const auto wide = search_server.FindTopDocuments("funny"s, wide_range);
+    ASSERT_EQUAL(wide.size(), 5);
+    ASSERT(std::none_of(wide.begin(), wide.end(), [](const Document& document) { return document.id == 14 || document.id == 15; }));
+    ASSERT_EQUAL(search_server.CountMatches("funny"s, wide_range), 6);
+    const int max_id = std::numeric_limits<int>::max();
+    search_server.AddDocument(max_id, "funny hamster"s, DocumentStatus::ACTUAL, { 9 });
+    search_server.AddDocument(max_id - 1, "funny hamster"s, DocumentStatus::ACTUAL, { 20 });
+    ASSERT_EQUAL(search_server.CountMatches("funny"s, wide_range), 7);
+    ASSERT_EQUAL(search_server.CountMatches("hamster"s, DocumentFilter().WithRatingAtLeast(0)), 8);
+    ASSERT_EQUAL(search_server.CountMatches("hamster"s, DocumentFilter().WithRatingAtLeast(12)), 5);
+    const auto top_rated = search_server.FindTopDocuments("hamster"s, DocumentFilter().WithRatingAtLeast(12).WithRatingAtMost(20));
+    ASSERT_EQUAL(top_rated.size(), 5u);
+    ASSERT(std::any_of(top_rated.begin(), top_rated.end(), [max_id](const Document& document) { return document.id == max_id - 1; }));
+    search_server.RemoveDocument(max_id);
+    search_server.RemoveDocument(max_id - 1);
+    ASSERT_EQUAL(search_server.CountMatches("funny"s, wide_range), 6);
+
+    search_server.RemoveDocument(4);
+    ASSERT(search_server.FindTopDocuments("funny rat"s, DocumentStatus::IRRELEVANT).empty());
+}
+
+void TestBm25Scoring() {
+    SearchServer search_server("and"s);
+    search_server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "cat dog bird and fish"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "hedgehog in the fog"s, DocumentStatus::BANNED, { 3 });
+    const auto found_docs = search_server.FindTopDocuments<Bm25Scoring>("cat"s);
+    ASSERT_EQUAL(found_docs.size(), 2);
+    ASSERT_EQUAL(found_docs[0].id, 1);
+    ASSERT_EQUAL(found_docs[1].id, 2);
+    const double term_weight = log(1.0 + (3.0 - 2.0 + 0.5) / (2.0 + 0.5));
+    const double average_word_count = (2.0 + 4.0 + 4.0) / 3.0;
+    ASSERT(std::abs(found_docs[0].relevance - term_weight * 2.2 / (1.0 + 1.2 * (0.25 + 0.75 * 2.0 / average_word_count))) < 1e-9);
+    ASSERT(std::abs(found_docs[1].relevance - term_weight * 2.2 / (1.0 + 1.2 * (0.25 + 0.75 * 4.0 / average_word_count))) < 1e-9);
+
+    const auto par_docs = search_server.FindTopDocuments<Bm25Scoring>(std::execution::par, "cat fog"s, [](int, DocumentStatus, int rating) { return rating > 1; });
+    ASSERT_EQUAL(par_docs.size(), 2);
+    ASSERT_EQUAL(par_docs[0].id, 3);
+}
+
+void TestQuantizedImpactScoring() {
+    SearchServer search_server("and with"s);
+    int id = 0;
+    for (
+        const std::string& text : {
+            "funny pet and nasty rat"s,
+            "funny pet with curly hair"s,
+            "funny pet and not very nasty rat"s,
+            "pet with rat and rat and rat"s,
+            "nasty rat with curly hair"s,
+            "white cat and yellow hat"s,
+        }
+        ) {
+        ++id;
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+    }
+    const std::string query = "curly nasty rat -not"s;
+    const auto exact_docs = search_server.FindTopDocuments(query);
+    ASSERT(search_server.FindTopDocuments<QuantizedImpactScoring>(query).size() == exact_docs.size());
+
+    for (const auto precision : { ImpactPrecision::UINT8, ImpactPrecision::UINT16 }) {
+        search_server.BuildImpactIndex(precision);
+        const double tolerance = precision == ImpactPrecision::UINT8 ? 1e-2 : 1e-4;
+        for (const auto& found_docs : { search_server.FindTopDocuments<QuantizedImpactScoring>(query),
+                                        search_server.FindTopDocuments<QuantizedImpactScoring>(std::execution::par, query) }) {
+            ASSERT_EQUAL(found_docs.size(), exact_docs.size());
+            for (const Document& found_doc : found_docs) {
+                const auto exact_doc = std::find_if(exact_docs.begin(), exact_docs.end(), [&found_doc](const Document& document) {
+                    return document.id == found_doc.id;
+                    });
+                ASSERT(exact_doc != exact_docs.end());
+                ASSERT(std::abs(found_doc.relevance - exact_doc->relevance) < tolerance);
+            }
+        }
+    }
+
+    search_server.AddDocument(7, "curly rat"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(search_server.FindTopDocuments<QuantizedImpactScoring>(query)[0].id, 7);
+}
+
+void TestForwardIndexOptional() {
+    SearchServer search_server("and in on"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    search_server.AddDocument(3, "big cat fancy collar"s, DocumentStatus::ACTUAL, { 1, 2, 8 });
+
+    search_server.SetForwardIndexEnabled(false);
+    bool thrown = false;
+    try {
+        search_server.GetWordFrequencies(1);
+    }
+    catch (const std::logic_error&) {
+        thrown = true;
+    }
+    ASSERT_HINT(thrown, "GetWordFrequencies requires the forward index"s);
+
+    const auto [words, status] = search_server.MatchDocument("fancy cat -dog"s, 3);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT(std::get<0>(search_server.MatchDocument("fancy cat -dog"s, 2)).empty());
+
+    search_server.RemoveDocument(2);
+    ASSERT_EQUAL(search_server.FindTopDocuments("dog"s).size(), 0u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("collar"s).size(), 1u);
+
+    search_server.AddDocument(4, "white dog"s, DocumentStatus::ACTUAL, { 5 });
+    search_server.SetForwardIndexEnabled(true);
+    const auto word_frequencies = search_server.GetWordFrequencies(1);
+    ASSERT_EQUAL(word_frequencies.size(), 3u);
+    for (const auto& [word, term_freq] : word_frequencies) {
+        ASSERT_EQUAL(term_freq, word == "curly"s ? 0.5 : 0.25);
+    }
+    ASSERT_EQUAL(search_server.GetWordFrequencies(4).size(), 2u);
+    ASSERT(search_server.GetWordFrequencies(2).empty());
+
+    search_server.RemoveDocument(4);
+    ASSERT_EQUAL(std::get<0>(search_server.MatchDocument("curly tail"s, 1)).size(), 2u);
+}
+
+void TestCursorPagination() {
+    SearchServer search_server("and with"s);
+    const std::vector<std::string> texts = {
+        "funny pet and nasty rat"s,
+        "funny pet with curly hair"s,
+        "pet with rat and rat and rat"s,
+        "nasty rat with curly hair"s,
+    };
+    for (int id = 0; id < 200; ++id) {
+        search_server.AddDocument(id, texts[id % texts.size()], id % 10 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id % 3 });
+    }
+    const size_t page_size = 7;
+    const DocumentFilter filter(DocumentStatus::ACTUAL);
+
+    std::vector<Document> seq_documents;
+    std::vector<Document> par_documents;
+    std::string token;
+    for (bool has_more = true; has_more;) {
+        const SearchCursor cursor = SearchCursor::Decode(token);
+        const auto seq_page = search_server.FindTopDocuments("rat curly"s, filter, cursor, page_size);
+        const auto par_page = search_server.FindTopDocuments(std::execution::par, "rat curly"s, filter, cursor, page_size);
+        ASSERT_EQUAL(seq_page.size(), par_page.size());
+        ASSERT(seq_page.size() <= page_size);
+        seq_documents.insert(seq_documents.end(), seq_page.begin(), seq_page.end());
+        par_documents.insert(par_documents.end(), par_page.begin(), par_page.end());
+        has_more = !seq_page.empty();
+        if (has_more) {
+            token = SearchCursor(seq_page.back()).Encode();
+        }
+    }
+
+    ASSERT_EQUAL(seq_documents.size(), 180u);
+    ASSERT(std::is_sorted(seq_documents.begin(), seq_documents.end(), ComesBefore));
+    ASSERT(std::adjacent_find(seq_documents.begin(), seq_documents.end(), [](const Document& lhs, const Document& rhs) {
+        return !ComesBefore(lhs, rhs);
+        }) == seq_documents.end());
+    for (size_t i = 0; i < seq_documents.size(); ++i) {
+        ASSERT_EQUAL(seq_documents[i].id, par_documents[i].id);
+    }
+    ASSERT_EQUAL(search_server.FindTopDocuments("rat curly"s, SearchCursor(), MAX_RESULT_DOCUMENT_COUNT).size(), MAX_RESULT_DOCUMENT_COUNT);
+
+    auto pages = PaginateLazily<SearchCursor>([&search_server, &filter](const SearchCursor& cursor, size_t size) {
+        return search_server.FindTopDocuments("rat curly"s, filter, cursor, size);
+        }, page_size);
+    size_t index = 0;
+    for (const auto& page : pages) {
+        for (const Document& document : page) {
+            ASSERT_EQUAL(document.id, seq_documents[index++].id);
+        }
+    }
+    ASSERT_EQUAL(index, seq_documents.size());
+
+    bool thrown = false;
+    try {
+        SearchCursor::Decode("12:3"s);
+    }
+    catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+}
+
+void TestCountMatchesAndAggregate() {
+    SearchServer search_server("and with"s);
+    const std::vector<std::string> texts = {
+        "funny pet and nasty rat"s,
+        "funny pet with curly hair"s,
+        "pet with rat and rat and rat"s,
+        "nasty rat with curly hair"s,
+    };
+    const std::vector<DocumentStatus> statuses = { DocumentStatus::ACTUAL, DocumentStatus::BANNED, DocumentStatus::IRRELEVANT };
+    for (int id = 0; id < 300; ++id) {
+        search_server.AddDocument(id * 5, texts[id % texts.size()], statuses[id % statuses.size()], { id % 7 - 3 });
+    }
+
+    for (const std::string& query : { "rat"s, "curly -nasty"s, "funny hair -pet"s, "dog"s }) {
+        int expected_count = 0;
+        std::map<DocumentStatus, int> expected_statuses;
+        std::map<int, int> expected_buckets;
+        for (int id = 0; id < 300; ++id) {
+            const auto [words, status] = search_server.MatchDocument(query, id * 5);
+            if (!words.empty()) {
+                const int rating = id % 7 - 3;
+                ++expected_count;
+                ++expected_statuses[status];
+                ++expected_buckets[rating >= 0 ? rating / 2 * 2 : (rating - 1) / 2 * 2];
+            }
+        }
+        const MatchAggregation aggregation = search_server.Aggregate(query, DocumentFilter(), 2);
+        ASSERT_EQUAL(aggregation.total, expected_count);
+        ASSERT(aggregation.status_counts == expected_statuses);
+        ASSERT(aggregation.rating_bucket_counts == expected_buckets);
+        ASSERT_EQUAL(search_server.CountMatches(query), expected_statuses[DocumentStatus::ACTUAL]);
+        ASSERT_EQUAL(search_server.Aggregate(query).total, search_server.CountMatches(query));
+    }
+
+    // Карта частого слова кешируется и должна сбрасываться при добавлении и удалении документов
+    for (int id = 0; id < 100; ++id) {
+        search_server.AddDocument(2000 + id, "rat"s, DocumentStatus::ACTUAL, {});
+    }
+    const int rat_count = search_server.CountMatches("rat"s, DocumentFilter());
+    ASSERT_EQUAL(rat_count, 325);
+    search_server.AddDocument(3000, "rat"s, DocumentStatus::ACTUAL, {});
+    ASSERT_EQUAL(search_server.CountMatches("rat"s, DocumentFilter()), rat_count + 1);
+    search_server.RemoveDocuments({ 2000, 2001 });
+    search_server.RemoveDocument(std::execution::par, 2002);
+    ASSERT_EQUAL(search_server.CountMatches("rat"s, DocumentFilter()), rat_count - 2);
+    ASSERT_EQUAL(search_server.CountMatches("funny rat"s, DocumentFilter()), rat_count - 2 + 75);
+
+    // Документы редкого слова добавляются в результат и вычитаются из него без отдельной карты
+    search_server.AddDocument(std::numeric_limits<int>::max(), "rat hamster"s, DocumentStatus::ACTUAL, {});
+    ASSERT_EQUAL(search_server.CountMatches("hamster"s), 1);
+    ASSERT_EQUAL(search_server.CountMatches("rat hamster"s, DocumentFilter()), rat_count - 1);
+    ASSERT_EQUAL(search_server.CountMatches("rat -hamster"s, DocumentFilter()), rat_count - 2);
+
+    const DocumentFilter filter = DocumentFilter(DocumentStatus::BANNED).WithRatingAtLeast(1);
+    const int filtered_count = search_server.CountMatches("rat"s, filter);
+    ASSERT_EQUAL(filtered_count, static_cast<int>(search_server.FindTopDocuments("rat"s, filter, SearchCursor(), 1000).size()));
+    ASSERT_EQUAL(search_server.Aggregate("rat"s, filter).total, filtered_count);
+}
+
+void TestMetrics() {
+    for (const uint64_t value : { 0ull, 31ull, 32ull, 1000ull, 123456789ull }) {
+        const size_t index = LatencyHistogram::GetBucketIndex(value);
+        ASSERT(value <= LatencyHistogram::GetBucketUpperBound(index));
+        ASSERT(index == 0 || LatencyHistogram::GetBucketUpperBound(index - 1) < value);
+        ASSERT(LatencyHistogram::GetBucketUpperBound(index) - value <= value / 16);
+    }
+
+    SearchServer search_server("and with"s);
+    ResetMetrics();
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    for (int i = 0; i < 10; ++i) {
+        search_server.FindTopDocuments("curly rat"s);
+    }
+    search_server.MatchDocument("curly rat"s, 3);
+    search_server.RemoveDocument(2);
+
+    const MetricsSnapshot snapshot = TakeMetricsSnapshot();
+#ifndef SEARCH_SERVER_DISABLE_METRICS
+    ASSERT_EQUAL(snapshot[MetricStage::ADD_DOCUMENT].count, 3u);
+    ASSERT_EQUAL(snapshot[MetricStage::SCORING].count, 10u);
+    ASSERT_EQUAL(snapshot[MetricStage::TOP_K].count, 10u);
+    ASSERT_EQUAL(snapshot[MetricStage::PARSE_QUERY].count, 11u);
+    ASSERT_EQUAL(snapshot[MetricStage::MATCH_DOCUMENT].count, 1u);
+    ASSERT_EQUAL(snapshot[MetricStage::REMOVE_DOCUMENT].count, 1u);
+    ASSERT_EQUAL(snapshot[MetricCounter::POSTINGS_SCANNED], 40u);
+    ASSERT_EQUAL(snapshot[MetricCounter::DOCUMENTS_SCORED], 30u);
+#endif
+    const StageMetrics& scoring = snapshot[MetricStage::SCORING];
+    ASSERT(scoring.GetQuantile(0.5) <= scoring.GetQuantile(0.99));
+    ASSERT(scoring.GetQuantile(0.99) <= scoring.GetQuantile(0.999));
+}
+
+void TestQueryProfile() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+    search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(4, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, { 3 });
+
+    for (const bool parallel : { false, true }) {
+        QueryProfile profile;
+        const auto documents = parallel
+            ? search_server.ProfileFindTopDocuments(std::execution::par, "curly rat -nasty"s, DocumentFilter(DocumentStatus::ACTUAL), profile)
+            : search_server.ProfileFindTopDocuments("curly rat -nasty"s, DocumentFilter(DocumentStatus::ACTUAL), profile);
+        ASSERT_EQUAL(documents.size(), 1u);
+        ASSERT_EQUAL(documents[0].id, 4);
+        ASSERT_EQUAL(profile.execution_path, parallel ? "par"s : "seq"s);
+        ASSERT_EQUAL(profile.index, "inverted"s);
+        ASSERT_EQUAL(profile.result_count, 1u);
+        ASSERT_EQUAL(profile.accumulator_size, 3u);
+        ASSERT_EQUAL(profile.terms.size(), 3u);
+
+        const TermProfile& curly = profile.terms[0];
+        ASSERT_EQUAL(curly.word, "curly"s);
+        ASSERT_EQUAL(curly.posting_length, 2u);
+        ASSERT_EQUAL(curly.postings_visited, 2u);
+        ASSERT_EQUAL(curly.skipped_by_filter, 1u);
+        ASSERT(std::abs(curly.idf - log(4.0 / 2.0)) < 1e-9);
+
+        const TermProfile& rat = profile.terms[1];
+        ASSERT_EQUAL(rat.postings_visited, 3u);
+        ASSERT_EQUAL(rat.skipped_by_filter, 0u);
+
+        const TermProfile& nasty = profile.terms[2];
+        ASSERT(nasty.is_minus);
+        ASSERT_EQUAL(nasty.skipped_by_minus, 2u);
+    }
+
+    QueryProfile profile;
+    const auto [words, status] = search_server.ProfileMatchDocument("curly rat -pet"s, 3, profile);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT_EQUAL(profile.result_count, 2u);
+    ASSERT_EQUAL(profile.index, "forward"s);
+    ASSERT_EQUAL(profile.terms.size(), 3u);
+    ASSERT_EQUAL(profile.terms[2].posting_length, 3u);
+}
+
+void TestAsyncSearchAdmission() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+    search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+
+    AdmissionOptions options;
+    options.worker_count = 1;
+    options.max_queue_depth = 3;
+    options.max_estimated_wait = 0ns;
+    AsyncSearchExecutor executor(search_server, options);
+
+    const auto expected = search_server.FindTopDocuments("curly rat"s);
+    const auto documents = executor.Submit({ "curly rat"s }).get();
+    ASSERT_EQUAL(documents.size(), expected.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        ASSERT_EQUAL(documents[i].id, expected[i].id);
+    }
+    ASSERT_EQUAL(executor.Submit({ "curly"s, DocumentFilter(DocumentStatus::BANNED) }).get().at(0).id, 2);
+    try {
+        executor.Submit({ "rat --pet"s }).get();
+        ASSERT_HINT(false, "invalid query must fail"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    // Единственный обработчик занят, пока не выполнится release: запросы копятся в очереди
+    std::promise<void> started;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    ASSERT(executor.TrySubmit({ "rat"s }, [&started, released](std::vector<Document>, std::exception_ptr) {
+        started.set_value();
+        released.wait();
+        }));
+    started.get_future().wait();
+
+    std::mutex order_mutex;
+    std::vector<std::string> order;
+    std::promise<void> all_done;
+    const auto record = [&](std::string name) {
+        return [&, name](std::vector<Document>, std::exception_ptr) {
+            std::lock_guard guard(order_mutex);
+            order.push_back(name);
+            if (order.size() == 3) {
+                all_done.set_value();
+            }
+        };
+    };
+    ASSERT(executor.TrySubmit({ "rat"s, DocumentFilter(), 5, QueryPriority::LOW }, record("low"s)));
+    ASSERT(executor.TrySubmit({ "rat"s, DocumentFilter(), 5, QueryPriority::NORMAL }, record("normal"s)));
+    ASSERT(executor.TrySubmit({ "rat"s, DocumentFilter(), 5, QueryPriority::HIGH }, record("high"s)));
+    ASSERT_EQUAL(executor.GetQueueDepth(), 3u);
+
+    ASSERT(!executor.TrySubmit({ "rat"s }, record("rejected"s)));
+    try {
+        executor.Submit({ "rat"s }).get();
+        ASSERT_HINT(false, "overloaded executor must reject the query"s);
+    }
+    catch (const QueryRejectedError&) {
+    }
+
+    release.set_value();
+    all_done.get_future().wait();
+    ASSERT((order == std::vector<std::string>{ "high"s, "normal"s, "low"s }));
+    const AdmissionStats stats = executor.GetStats();
+    ASSERT_EQUAL(stats.rejected, 2u);
+    ASSERT_EQUAL(stats.accepted, 7u);
+
+    // Выдача совпадает с синхронной, включая порядок по рейтингу при равной релевантности, и усекается до max_results
+    for (int id = 10; id < 20; ++id) {
+        search_server.AddDocument(id, "hamster"s, DocumentStatus::ACTUAL, { id % 4 });
+    }
+    const auto sync_documents = search_server.FindTopDocuments("hamster"s);
+    const auto async_documents = executor.Submit({ "hamster"s, DocumentFilter(DocumentStatus::ACTUAL), 3 }).get();
+    ASSERT_EQUAL(async_documents.size(), 3u);
+    for (size_t i = 0; i < async_documents.size(); ++i) {
+        ASSERT_EQUAL(async_documents[i].id, sync_documents[i].id);
+    }
+}
+
+void TestAsyncSearchShutdown() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    AdmissionOptions options;
+    options.worker_count = 1;
+    options.max_estimated_wait = 0ns;
+
+    // Callback ожидающих запросов вызываются в потоке обработчика, а не в потоке, уничтожающем исполнитель
+    std::mutex mutex;
+    std::vector<std::thread::id> callback_threads;
+    int rejected_count = 0;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::thread releaser;
+    {
+        auto executor = std::make_unique<AsyncSearchExecutor>(search_server, options);
+        std::promise<void> started;
+        ASSERT(executor->TrySubmit({ "rat"s }, [&started, released](std::vector<Document>, std::exception_ptr) {
+            started.set_value();
+            released.wait();
+            }));
+        started.get_future().wait();
+        for (int i = 0; i < 3; ++i) {
+            ASSERT(executor->TrySubmit({ "rat"s }, [&](std::vector<Document>, std::exception_ptr error) {
+                std::lock_guard guard(mutex);
+                callback_threads.push_back(std::this_thread::get_id());
+                if (error) {
+                    try {
+                        std::rethrow_exception(error);
+                    }
+                    catch (const QueryRejectedError&) {
+                        ++rejected_count;
+                    }
+                }
+                }));
+        }
+        releaser = std::thread([&release] {
+            std::this_thread::sleep_for(50ms);
+            release.set_value();
+            });
+        executor.reset();
+    }
+    releaser.join();
+    ASSERT_EQUAL(callback_threads.size(), 3u);
+    for (const std::thread::id thread_id : callback_threads) {
+        ASSERT(thread_id != std::this_thread::get_id());
+    }
+    ASSERT_EQUAL(rejected_count, 3);
+}
+
+void TestQueryBudget() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+    search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(4, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, { 3 });
+
+    const auto full = search_server.FindTopDocuments("rat curly"s, DocumentFilter());
+    for (const uint64_t max_postings : { uint64_t{ 0 }, uint64_t{ 5 }, uint64_t{ 100 } }) {
+        QueryBudget budget;
+        budget.max_postings = max_postings;
+        const PartialSearchResult result = search_server.FindTopDocuments("rat curly"s, DocumentFilter(), budget);
+        ASSERT(!result.partial);
+        ASSERT_EQUAL(result.postings_visited, 5u);
+        ASSERT_EQUAL(result.documents.size(), full.size());
+        for (size_t i = 0; i < full.size(); ++i) {
+            ASSERT_EQUAL(result.documents[i].id, full[i].id);
+        }
+    }
+
+    // Сначала обрабатывается более редкое слово curly, на частое rat бюджета не хватает
+    QueryBudget budget;
+    budget.max_postings = 2;
+    const PartialSearchResult result = search_server.FindTopDocuments("rat curly"s, DocumentFilter(), budget);
+    ASSERT(result.partial);
+    ASSERT_EQUAL(result.postings_visited, 2u);
+    ASSERT_EQUAL(result.documents.size(), 2u);
+    for (const Document& document : result.documents) {
+        ASSERT(document.id == 2 || document.id == 3);
+    }
+
+    for (const bool parallel : { false, true }) {
+        const QueryBudget expired = QueryBudget::WithTimeout(0ns);
+        const PartialSearchResult late = parallel
+            ? search_server.FindTopDocuments(std::execution::par, "rat curly"s, DocumentFilter(), expired)
+            : search_server.FindTopDocuments("rat curly"s, DocumentFilter(), expired);
+        ASSERT(late.partial);
+        ASSERT(late.documents.empty());
+
+        const PartialSearchResult in_time = parallel
+            ? search_server.FindTopDocuments(std::execution::par, "rat curly -hair"s, DocumentFilter(), QueryBudget::WithTimeout(1h))
+            : search_server.FindTopDocuments("rat curly -hair"s, DocumentFilter(), QueryBudget::WithTimeout(1h));
+        ASSERT(!in_time.partial);
+        ASSERT_EQUAL(in_time.documents.size(), 2u);
+    }
+}
+
+void TestWriteAheadLog() {
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_test_wal.log").string();
+    const auto check_restored = [&path](const SearchServer& original, size_t expected_added, size_t expected_removed) {
+        SearchServer restored("and with"s);
+        WriteAheadLog log(path);
+        const WalReplayStats stats = log.Replay(restored);
+        ASSERT_EQUAL(stats.added, expected_added);
+        ASSERT_EQUAL(stats.removed, expected_removed);
+        ASSERT((std::vector<int>(restored.begin(), restored.end()) == std::vector<int>(original.begin(), original.end())));
+        const auto expected = original.FindTopDocuments("curly rat"s, DocumentFilter());
+        const auto documents = restored.FindTopDocuments("curly rat"s, DocumentFilter());
+        ASSERT_EQUAL(documents.size(), expected.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL(documents[i].id, expected[i].id);
+            ASSERT_EQUAL(documents[i].rating, expected[i].rating);
+            ASSERT(std::abs(documents[i].relevance - expected[i].relevance) < ERROR_RATE);
+        }
+    };
+
+    for (const WalDurability durability : { WalDurability::BUFFERED, WalDurability::GROUP_COMMIT, WalDurability::SYNC }) {
+        std::filesystem::remove(path);
+        SearchServer search_server("and with"s);
+        {
+            WriteAheadLogOptions options;
+            options.durability = durability;
+            WriteAheadLog log(path, options);
+            search_server.SetWriteAheadLog(&log);
+            search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+            search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+            search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+            search_server.AddDocument(4, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, { 3 });
+            try {
+                search_server.AddDocument(4, "duplicate id"s, DocumentStatus::ACTUAL, {});
+            }
+            catch (const std::invalid_argument&) {
+            }
+            search_server.RemoveDocument(2);
+            search_server.RemoveDocuments({ 1 });
+            search_server.AddDocument(5, "curly rat"s, DocumentStatus::IRRELEVANT, { -1 });
+            log.Sync();
+            search_server.SetWriteAheadLog(nullptr);
+        }
+        check_restored(search_server, 5, 2);
+    }
+
+    // Запись, недописанная при сбое, отрезается, и журнал продолжается после последней целой записи
+    {
+        std::ofstream torn(path, std::ios::binary | std::ios::app);
+        torn << "\x10\0\0\0torn"s;
+    }
+    SearchServer search_server("and with"s);
+    {
+        WriteAheadLog log(path);
+        ASSERT_EQUAL(log.GetTruncatedBytes(), 8u);
+        log.Replay(search_server);
+        search_server.SetWriteAheadLog(&log);
+        search_server.AddDocument(6, "nasty curly pet"s, DocumentStatus::ACTUAL, { 4 });
+        search_server.SetWriteAheadLog(nullptr);
+    }
+    check_restored(search_server, 6, 2);
+    std::filesystem::remove(path);
+}
+
+void TestQueryStatistics() {
+    QueryStatisticsOptions options;
+    options.bucket_width = std::chrono::milliseconds(1000);
+    options.bucket_count = 3;
+    const auto start = QueryStatistics::Clock::now();
+    {
+        QueryStatistics statistics(options, start);
+        statistics.Record(0, start);
+        statistics.Record(2, start + 100ms);
+        statistics.Record(7, start + 1500ms);
+
+        const QueryStatisticsReport report = statistics.GetReport(start + 2s);
+        ASSERT_EQUAL(report.request_count, 3u);
+        ASSERT_EQUAL(report.no_result_count, 1u);
+        ASSERT_EQUAL(report.result_counts[2], 1u);
+        ASSERT_EQUAL(report.result_counts[QUERY_RESULT_COUNT_BUCKETS - 1], 1u);
+        ASSERT(report.window == 2s);
+        ASSERT(std::abs(report.qps - 1.5) < 1e-9);
+        ASSERT(std::abs(report.no_result_rate - 1.0 / 3.0) < 1e-9);
+
+        // Первая секунда вышла из окна, её корзина переиспользуется для четвёртой
+        statistics.Record(0, start + 3200ms);
+        const QueryStatisticsReport later = statistics.GetReport(start + 3500ms);
+        ASSERT_EQUAL(later.request_count, 2u);
+        ASSERT_EQUAL(later.no_result_count, 1u);
+        ASSERT_EQUAL(later.result_counts[2], 0u);
+        ASSERT(later.window == 2500ms);
+    }
+
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    std::vector<std::string> queries;
+    for (int i = 0; i < 1000; ++i) {
+        queries.push_back(i % 4 == 0 ? "dog"s : "curly hair"s);
+    }
+    QueryStatistics statistics;
+    ProcessQueries(search_server, queries, statistics);
+    RequestQueue request_queue(search_server, statistics);
+    request_queue.AddFindRequest("dog"s);
+    request_queue.AddFindRequest("funny"s);
+    const QueryStatisticsReport report = statistics.GetReport();
+    ASSERT_EQUAL(report.request_count, 1002u);
+    ASSERT_EQUAL(report.no_result_count, 251u);
+    ASSERT_EQUAL(report.result_counts[2], 751u);
+}
+
+// Ресурс памяти, считающий выделенные через него байты
+class CountingMemoryResource : public std::pmr::memory_resource {
+public:
+    size_t allocated_bytes = 0;
+    size_t used_bytes = 0; // Выделено и ещё не освобождено
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        allocated_bytes += bytes;
+        used_bytes += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        used_bytes -= bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+void TestMemoryResource() {
+    const auto fill = [](SearchServer& search_server) {
+        search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+        search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+        search_server.AddDocument(3, "nasty rat with curly hair"s, DocumentStatus::BANNED, { 1, 2 });
+        search_server.AddDocument(4, "big dog with curly tail"s, DocumentStatus::ACTUAL, { 5 });
+        search_server.AddDocument(5, "nasty cat and funny dog"s, DocumentStatus::ACTUAL, { 3, 3 });
+    };
+    SearchServer expected_server("and with"s);
+    fill(expected_server);
+    const std::vector<std::string> queries = { "curly pet"s, "nasty -rat"s, "funny dog"s };
+    const auto assert_same_documents = [](const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT(std::abs(lhs[i].relevance - rhs[i].relevance) < 1e-9);
+        }
+    };
+
+    CountingMemoryResource upstream;
+    {
+        std::pmr::monotonic_buffer_resource arena(&upstream);
+        SearchServer search_server("and with"s, &arena);
+        fill(search_server);
+        ASSERT(upstream.allocated_bytes > 0);
+        for (const std::string& query : queries) {
+            assert_same_documents(search_server.FindTopDocuments(query), expected_server.FindTopDocuments(query));
+            assert_same_documents(search_server.FindTopDocuments(std::execution::par, query), expected_server.FindTopDocuments(query));
+        }
+        ASSERT(std::equal(search_server.begin(), search_server.end(), expected_server.begin(), expected_server.end()));
+
+        // Параллельное удаление освобождает узлы из нескольких потоков: арене это безопасно
+        search_server.RemoveDocument(std::execution::par, 2);
+        search_server.RemoveDocuments({ 3, 4 });
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 2);
+        ASSERT_EQUAL(search_server.FindTopDocuments("curly"s).size(), 0u);
+        ASSERT_EQUAL(search_server.FindTopDocuments("funny"s).size(), 2u);
+    }
+
+    std::pmr::synchronized_pool_resource pool(&upstream);
+    SearchServer search_server("and with"s, &pool);
+    fill(search_server);
+    search_server.RemoveDocument(std::execution::par, 1);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    for (const std::string& query : queries) {
+        assert_same_documents(search_server.FindTopDocuments(query), expected_server.FindTopDocuments(query));
+    }
+    const auto [words, status] = search_server.MatchDocument("nasty pet"s, 1);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT(status == DocumentStatus::ACTUAL);
+}
+
+void TestConjunctiveQuery() {
+    SearchServer search_server("and with"s);
+    const std::vector<std::string> texts = {
+        "funny pet and nasty rat"s,
+        "funny pet with curly hair"s,
+        "funny pet and not very nasty rat"s,
+        "pet with rat and rat and rat"s,
+        "nasty rat with curly hair"s,
+        "curly dog"s,
+    };
+    for (int id = 0; id < 600; ++id) {
+        search_server.AddDocument(id * 3, texts[id % texts.size()] + (id % 97 == 0 ? " parrot"s : ""s),
+            id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id });
+    }
+
+    // Ожидаемая выдача - выдача ANY среди документов, где MatchDocument нашёл все плюс-слова
+    const auto check = [&search_server](const std::string& query, size_t plus_word_count) {
+        std::set<int> all_words_ids;
+        for (const int document_id : search_server) {
+            const auto [words, status] = search_server.MatchDocument(query, document_id);
+            if (status == DocumentStatus::ACTUAL && words.size() == plus_word_count) {
+                all_words_ids.insert(document_id);
+            }
+        }
+        const auto expected = search_server.FindTopDocuments(query, [&all_words_ids](int document_id, DocumentStatus, int) {
+            return all_words_ids.count(document_id) > 0;
+            });
+        for (const auto& documents : { search_server.FindTopDocuments(query, DocumentFilter(DocumentStatus::ACTUAL), QueryMatchMode::ALL),
+            search_server.FindTopDocuments(std::execution::par, query, DocumentFilter(DocumentStatus::ACTUAL), QueryMatchMode::ALL) }) {
+            ASSERT_EQUAL_HINT(documents.size(), expected.size(), query);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, query);
+                ASSERT(std::abs(documents[i].relevance - expected[i].relevance) < 1e-9);
+            }
+        }
+    };
+    check("curly hair"s, 2);
+    check("funny nasty rat"s, 3);
+    check("parrot rat"s, 2);
+    check("parrot curly -hair"s, 2);
+    check("pet -nasty"s, 1);
+    check("rat"s, 1);
+    ASSERT(search_server.FindTopDocuments("curly elephant"s, DocumentFilter(), QueryMatchMode::ALL).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("parrot rat"s, DocumentFilter(), QueryMatchMode::ANY).size(), MAX_RESULT_DOCUMENT_COUNT);
+
+    const auto bm25_documents = search_server.FindTopDocuments<Bm25Scoring>("curly nasty"s, DocumentFilter(), QueryMatchMode::ALL);
+    ASSERT(!bm25_documents.empty());
+    for (const Document& document : bm25_documents) {
+        ASSERT_EQUAL(document.id / 3 % texts.size(), 4u);
+    }
+}
+
+void TestChampionLists() {
+    SearchServer search_server("and with"s);
+    const auto add_document = [&search_server](int id) {
+        std::string text = "cat "s;
+        for (int i = 0; i <= id % 4 && id % 5 != 4; ++i) {
+            text += "pet "s;
+        }
+        for (int i = 1; i <= id % 7; ++i) {
+            text += "word"s + std::to_string(i) + " "s;
+        }
+        search_server.AddDocument(id, text, id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id });
+    };
+    // Выдача без списков чемпионов: запросы с предикатом обходят список документов слова
+    const auto check = [&search_server](const std::string& query) {
+        const auto expected = search_server.FindTopDocuments(query, [](int, DocumentStatus status, int) {
+            return status == DocumentStatus::BANNED;
+            });
+        for (const auto& documents : { search_server.FindTopDocuments(query, DocumentStatus::BANNED),
+            search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED) }) {
+            ASSERT_EQUAL_HINT(documents.size(), expected.size(), query);
+            for (size_t i = 0; i < documents.size(); ++i) {
+                ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, query);
+                ASSERT(std::abs(documents[i].relevance - expected[i].relevance) < 1e-9);
+            }
+        }
+    };
+
+    for (int id = 0; id < 1200; ++id) {
+        add_document(id);
+    }
+    ResetMetrics();
+    // "cat" есть во всех документах: релевантность нулевая, и выдача по спискам невозможна
+    check("pet"s);
+    check("word1"s);
+    check("word5"s);
+    check("cat"s);
+    check("pet word3"s);
+#ifndef SEARCH_SERVER_DISABLE_METRICS
+    ASSERT_EQUAL(TakeMetricsSnapshot()[MetricCounter::CHAMPION_LIST_HITS], 6u);
+
+    // Запрос, не выданный по спискам, разбирается один раз
+    ResetMetrics();
+    search_server.FindTopDocuments("pet word3"s, DocumentStatus::BANNED);
+    ASSERT_EQUAL(TakeMetricsSnapshot()[MetricStage::PARSE_QUERY].count, 1u);
+#endif
+    // Перегрузки с бюджетом и с режимом совпадения тоже используют списки
+    ResetMetrics();
+    const auto expected = search_server.FindTopDocuments("pet"s, DocumentStatus::BANNED);
+    const auto conjunctive = search_server.FindTopDocuments("pet"s, DocumentFilter(DocumentStatus::BANNED), QueryMatchMode::ALL);
+    const auto budgeted = search_server.FindTopDocuments("pet"s, DocumentFilter(DocumentStatus::BANNED), QueryBudget());
+    ASSERT(!budgeted.partial);
+    for (const auto* documents : { &conjunctive, &budgeted.documents }) {
+        ASSERT_EQUAL(documents->size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL((*documents)[i].id, expected[i].id);
+        }
+    }
+    // Профиль отражает тот же путь выполнения
+    QueryProfile profile;
+    const auto profiled = search_server.ProfileFindTopDocuments("pet"s, DocumentFilter(DocumentStatus::BANNED), profile);
+    ASSERT_EQUAL(profiled.size(), expected.size());
+    ASSERT_EQUAL(profile.index, "champion"sv);
+    ASSERT_EQUAL(profile.result_count, expected.size());
+#ifndef SEARCH_SERVER_DISABLE_METRICS
+    ASSERT_EQUAL(TakeMetricsSnapshot()[MetricCounter::CHAMPION_LIST_HITS], 4u);
+#endif
+
+    // Удаление лучших документов опустошает списки и вызывает их пересборку
+    for (int round = 0; round < 30; ++round) {
+        const auto top = search_server.FindTopDocuments("pet"s, DocumentStatus::BANNED);
+        search_server.RemoveDocument(top.front().id);
+        search_server.RemoveDocuments({ top[1].id, top[2].id });
+        search_server.RemoveDocument(std::execution::par, top[3].id);
+        check("pet"s);
+        check("word6"s);
+    }
+    for (int id = 1200; id < 1300; ++id) {
+        add_document(id);
+    }
+    check("pet"s);
+    check("word6"s);
+
+    // Слово стало редким: списки удалены, выдача прежняя
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    for (const int document_id : document_ids) {
+        if (document_id % 7 == 6 && document_id > 300) {
+            search_server.RemoveDocument(document_id);
+        }
+    }
+    check("word6"s);
+}
+
+void TestFuzzySearch() {
+    ASSERT_EQUAL(FuzzyTermIndex::ComputeEditDistance("cat"sv, "act"sv, 2), 1);
+    ASSERT_EQUAL(FuzzyTermIndex::ComputeEditDistance("cat"sv, "cats"sv, 2), 1);
+    ASSERT_EQUAL(FuzzyTermIndex::ComputeEditDistance("кот"sv, "кит"sv, 2), 1);
+    ASSERT_EQUAL(FuzzyTermIndex::ComputeEditDistance("nasty"sv, "nsti"sv, 2), 2);
+    ASSERT_EQUAL(FuzzyTermIndex::ComputeEditDistance("kitten"sv, "sitting"sv, 2), 3);
+
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    search_server.AddDocument(3, "пушистый кот"s, DocumentStatus::ACTUAL, { 5 });
+    ASSERT(search_server.FindTopDocuments("curli"s).empty());
+
+    const auto exact_documents = search_server.FindTopDocuments("curly"s);
+    search_server.SetFuzzySearchEnabled(true);
+    // Известные слова не заменяются
+    const auto known_documents = search_server.FindTopDocuments("curly"s);
+    ASSERT_EQUAL(known_documents.size(), 1u);
+    ASSERT(std::abs(known_documents[0].relevance - exact_documents[0].relevance) < 1e-9);
+
+    const auto fuzzy_documents = search_server.FindTopDocuments("curli"s);
+    ASSERT_EQUAL(fuzzy_documents.size(), 1u);
+    ASSERT_EQUAL(fuzzy_documents[0].id, 2);
+    ASSERT(std::abs(fuzzy_documents[0].relevance - exact_documents[0].relevance * 0.5) < 1e-9);
+
+    const auto nasty_documents = search_server.FindTopDocuments(std::execution::par, "nsti"s);
+    ASSERT_EQUAL(nasty_documents.size(), 1u);
+    ASSERT(std::abs(nasty_documents[0].relevance - search_server.FindTopDocuments("nasty"s)[0].relevance * 0.25) < 1e-9);
+    ASSERT_EQUAL(search_server.FindTopDocuments("кит"s).size(), 1u);
+    ASSERT(search_server.FindTopDocuments("curli -hair"s).empty());
+    ASSERT(search_server.FindTopDocuments("curli"s, DocumentFilter(), QueryMatchMode::ALL).empty());
+
+    // Индекс удалений следует за словарём
+    search_server.AddDocument(4, "talking parrot"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(search_server.FindTopDocuments("parot"s).size(), 1u);
+    search_server.RemoveDocument(4);
+    ASSERT(search_server.FindTopDocuments("parot"s).empty());
+    search_server.RemoveDocuments({ 3 });
+    ASSERT(search_server.FindTopDocuments("кит"s).empty());
+
+    search_server.SetFuzzySearchEnabled(false);
+    ASSERT(search_server.FindTopDocuments("curli"s).empty());
+}
+
+void TestPrefixQuery() {
+    std::vector<std::string> words;
+    for (int i = 0; i < 40; ++i) {
+        words.push_back("ph"s + static_cast<char>('a' + i % 26) + std::to_string(i));
+    }
+    words.push_back("фото"s);
+    words.push_back("фотон"s);
+    std::sort(words.begin(), words.end());
+    std::vector<TermDictionary::Entry> terms;
+    for (size_t i = 0; i < words.size(); ++i) {
+        terms.push_back({ words[i], static_cast<int>(i) * 10, static_cast<uint32_t>(i * 7 % 5) });
+    }
+    TermDictionary dictionary;
+    dictionary.Build(terms);
+    ASSERT_EQUAL(dictionary.GetTermCount(), words.size());
+    for (const auto& [term, term_id, _] : terms) {
+        ASSERT(dictionary.Find(term) == term_id);
+    }
+    ASSERT(!dictionary.Find("pha"sv));
+    ASSERT(!dictionary.Find("zzz"sv));
+    ASSERT_EQUAL(dictionary.FindPrefix("фот"sv).size(), 2u);
+    ASSERT_EQUAL(dictionary.FindPrefix("ph"sv).size(), 40u);
+    ASSERT_EQUAL(dictionary.FindPrefix("pha"sv).size(), 2u); // pha0 и pha26
+    ASSERT(dictionary.FindPrefix("q"sv).empty());
+    // Самые тяжёлые слова с префиксом совпадают с полным перебором: тяжелее, при равном весе - раньше
+    for (const std::string_view prefix : { "p"sv, "ph"sv, "pha"sv, "фот"sv, "q"sv }) {
+        for (const size_t limit : { 1u, 3u, 16u, 100u }) {
+            std::vector<std::pair<uint32_t, size_t>> expected;
+            for (size_t i = 0; i < terms.size(); ++i) {
+                if (terms[i].term.substr(0, prefix.size()) == prefix) {
+                    expected.emplace_back(terms[i].weight, i);
+                }
+            }
+            std::sort(expected.begin(), expected.end(), [](const auto& lhs, const auto& rhs) {
+                return lhs.first != rhs.first ? lhs.first > rhs.first : lhs.second < rhs.second;
+                });
+            expected.resize(std::min(expected.size(), limit));
+            const auto top = dictionary.FindTopPrefix(prefix, limit);
+            ASSERT_EQUAL_HINT(top.size(), expected.size(), std::string(prefix));
+            for (size_t i = 0; i < top.size(); ++i) {
+                ASSERT_EQUAL_HINT(top[i], terms[expected[i].second].term_id, std::string(prefix));
+            }
+        }
+    }
+    std::swap(terms[0], terms[1]);
+    try {
+        TermDictionary().Build(terms);
+        ASSERT_HINT(false, "unsorted terms must be rejected");
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "new phone with camera"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.AddDocument(2, "old photo of a cat"s, DocumentStatus::ACTUAL, { 2 });
+    search_server.AddDocument(3, "phonetic alphabet"s, DocumentStatus::ACTUAL, { 3 });
+    search_server.AddDocument(4, "graph of a cat"s, DocumentStatus::ACTUAL, { 4 });
+    const auto expected = search_server.FindTopDocuments("phone photo phonetic"s);
+    const auto check = [&search_server, &expected](const std::string& query) {
+        const auto documents = search_server.FindTopDocuments(query);
+        ASSERT_EQUAL_HINT(documents.size(), expected.size(), query);
+        for (size_t i = 0; i < documents.size(); ++i) {
+            ASSERT_EQUAL_HINT(documents[i].id, expected[i].id, query);
+            ASSERT(std::abs(documents[i].relevance - expected[i].relevance) < 1e-9);
+        }
+    };
+    check("pho*"s);
+    check("pho* photo"s);
+    search_server.SealTermDictionary();
+    check("pho*"s);
+    ASSERT_EQUAL(search_server.FindTopDocuments(std::execution::par, "phon* -alphabet"s).size(), 1u);
+    ASSERT(search_server.FindTopDocuments("xyz*"s).empty());
+    ASSERT(search_server.FindTopDocuments("pho*"s, DocumentFilter(), QueryMatchMode::ALL).empty());
+
+    // Изменение индекса распечатывает словарь, префиксы перечисляются по обратному индексу
+    search_server.AddDocument(5, "phoenix"s, DocumentStatus::ACTUAL, { 5 });
+    ASSERT(!search_server.IsTermDictionarySealed());
+    ASSERT_EQUAL(search_server.FindTopDocuments("pho*"s).size(), 4u);
+    search_server.SealTermDictionary();
+    search_server.RemoveDocument(1);
+    ASSERT(!search_server.IsTermDictionarySealed());
+    ASSERT_EQUAL(search_server.FindTopDocuments("pho*"s).size(), 3u);
+}
+
+void TestSealedTermDictionary() {
+    // Словарь запечатывается в том же ресурсе памяти, что и индекс: по нему видно, что дерево слов освобождено
+    CountingMemoryResource memory_resource;
+    SearchServer search_server("and with"s, &memory_resource);
+    for (int id = 0; id < 500; ++id) {
+        search_server.AddDocument(id, "photograph"s + std::to_string(id) + " phonetics"s + std::to_string(id % 7) + " and cat"s,
+            id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id % 10 });
+    }
+    search_server.AddDocument(1000, "photograph1 photograph2 dog"s, DocumentStatus::ACTUAL, { 1 });
+    search_server.BuildImpactIndex();
+    const std::vector<std::string> queries = { "photograph42 cat"s, "phonetics3 -cat"s, "phon*"s, "photo* dog"s, "unknown"s };
+    std::vector<std::vector<Document>> expected;
+    for (const std::string& query : queries) {
+        expected.push_back(search_server.FindTopDocuments(query));
+    }
+    const int expected_count = search_server.CountMatches("phonetics3 dog"s);
+    const size_t unsealed_bytes = memory_resource.used_bytes;
+
+    search_server.SealTermDictionary();
+    ASSERT(search_server.IsTermDictionarySealed());
+    ASSERT_HINT(memory_resource.used_bytes < unsealed_bytes, "sealing must release the word tree");
+
+    // Слова запросов, документов и списков чемпионов ищутся в запечатанном словаре
+    const auto check = [&]() {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto documents = search_server.FindTopDocuments(queries[i]);
+            ASSERT_EQUAL_HINT(documents.size(), expected[i].size(), queries[i]);
+            for (size_t j = 0; j < documents.size(); ++j) {
+                ASSERT_EQUAL_HINT(documents[j].id, expected[i][j].id, queries[i]);
+                ASSERT(std::abs(documents[j].relevance - expected[i][j].relevance) < 1e-9);
+            }
+        }
+        ASSERT_EQUAL(search_server.CountMatches("phonetics3 dog"s), expected_count);
+        const auto [words, status] = search_server.MatchDocument("photograph1 dog unknown"s, 1000);
+        ASSERT_EQUAL(words.size(), 2u);
+        ASSERT(status == DocumentStatus::ACTUAL);
+        ASSERT_EQUAL(search_server.GetWordFrequencies(1000).size(), 3u);
+    };
+    check();
+    search_server.SetDuplicatePolicy(DuplicatePolicy::REJECT);
+    try {
+        search_server.AddDocument(1001, "dog photograph2 photograph1"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "the duplicate must be found through the sealed dictionary");
+    }
+    catch (const std::invalid_argument&) {
+    }
+    ASSERT(search_server.IsTermDictionarySealed());
+
+    // Новый документ распечатывает словарь, ID старых слов сохраняются
+    search_server.AddDocument(1001, "parrot"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT(!search_server.IsTermDictionarySealed());
+    search_server.RemoveDocument(1001);
+    search_server.BuildImpactIndex();
+    check();
+    search_server.SealTermDictionary();
+    search_server.RemoveDocuments({ 1000 });
+    ASSERT(search_server.FindTopDocuments("dog"s).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("photograph43 cat"s).front().id, 43);
+}
+
 void TestSearchServer() {
     RUN_TEST(TestExcludeStopWordsFromAddedDocumentContent);
     RUN_TEST(TestExcludeStopWords);
@@ -392,5 +1666,30 @@ void TestSearchServer() {
     RUN_TEST(TestRemoveDuplicate);
     RUN_TEST(TestProcessQueries);
     RUN_TEST(TestProcessQueriesJoined);
+    RUN_TEST(TestParallelFindTopDocuments);
+    RUN_TEST(TestMatchDocuments);
+    RUN_TEST(TestRemoveDocuments);
+    RUN_TEST(TestFindNearDuplicates);
+    RUN_TEST(TestDuplicatePolicy);
+    RUN_TEST(TestDocumentBitmap);
+    RUN_TEST(TestFiltrationDocumentFilter);
+    RUN_TEST(TestBm25Scoring);
+    RUN_TEST(TestQuantizedImpactScoring);
+    RUN_TEST(TestForwardIndexOptional);
+    RUN_TEST(TestCursorPagination);
+    RUN_TEST(TestCountMatchesAndAggregate);
+    RUN_TEST(TestMetrics);
+    RUN_TEST(TestQueryProfile);
+    RUN_TEST(TestAsyncSearchAdmission);
+    RUN_TEST(TestAsyncSearchShutdown);
+    RUN_TEST(TestQueryBudget);
+    RUN_TEST(TestWriteAheadLog);
+    RUN_TEST(TestQueryStatistics);
+    RUN_TEST(TestMemoryResource);
+    RUN_TEST(TestConjunctiveQuery);
+    RUN_TEST(TestChampionLists);
+    RUN_TEST(TestFuzzySearch);
+    RUN_TEST(TestPrefixQuery);
+    RUN_TEST(TestSealedTermDictionary);
     std::cout << "All tests complite!\n" << std::endl;
 }
\ No newline at end of file
@@ -52,4 +52,53 @@ void TestProcessQueries();
 
 void TestProcessQueriesJoined();
 
+void TestParallelFindTopDocuments();
+
+void TestMatchDocuments();
+
+void TestRemoveDocuments();
+
+void TestFindNearDuplicates();
+
+void TestDuplicatePolicy();
+
+void TestDocumentBitmap();
+
+void TestFiltrationDocumentFilter();
+
+void TestBm25Scoring();
+
+void TestQuantizedImpactScoring();
+
+void TestForwardIndexOptional();
+
+void TestCursorPagination();
+
+void TestCountMatchesAndAggregate();
+
+void TestMetrics();
+
+void TestQueryProfile();
+
+void TestAsyncSearchAdmission();
+
+void TestAsyncSearchShutdown();
+
+void TestQueryBudget();
+
+void TestWriteAheadLog();
+
+void TestQueryStatistics();
+
+void TestMemoryResource();
+
+void TestConjunctiveQuery();
+
+void TestChampionLists();
+
+void TestFuzzySearch();
+
+void TestPrefixQuery();
+void TestSealedTermDictionary();
+
 void TestSearchServer();
\ No newline at end of file
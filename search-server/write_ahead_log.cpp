@@ -0,0 +1,302 @@
+#include "write_ahead_log.h"
+
+#include "search_server.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t); // Длина данных и их CRC32
+const uint32_t MAX_RECORD_SIZE = uint32_t{ 1 } << 30;
+
+std::array<uint32_t, 256> MakeCrcTable() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < table.size(); ++i) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+uint32_t ComputeCrc32(std::string_view data) {
+    static const std::array<uint32_t, 256> table = MakeCrcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFFu] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Числа записываются в порядке байт машины: журнал читается на той же машине, что его писала
+template <typename T>
+void AppendValue(std::string& output, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    output.append(bytes, sizeof(T));
+}
+
+class PayloadReader {
+public:
+    explicit PayloadReader(std::string_view payload)
+        : payload_(payload) {
+    }
+
+    template <typename T>
+    T Read() {
+        T value;
+        std::memcpy(&value, Take(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    std::string_view Take(size_t size) {
+        if (size > payload_.size()) {
+            throw std::runtime_error("corrupted write-ahead log record");
+        }
+        const std::string_view result = payload_.substr(0, size);
+        payload_.remove_prefix(size);
+        return result;
+    }
+
+private:
+    std::string_view payload_;
+};
+
+// Передаёт данные каждой целой записи в handle_payload, возвращает размер префикса файла из целых записей
+template <typename HandlePayload>
+size_t ForEachRecord(const std::string& path, HandlePayload handle_payload) {
+    std::ifstream input(path, std::ios::binary);
+    size_t valid_size = 0;
+    std::string payload;
+    char header[RECORD_HEADER_SIZE];
+    while (input.read(header, RECORD_HEADER_SIZE)) {
+        uint32_t size;
+        uint32_t crc;
+        std::memcpy(&size, header, sizeof(size));
+        std::memcpy(&crc, header + sizeof(size), sizeof(crc));
+        if (size > MAX_RECORD_SIZE) {
+            break;
+        }
+        payload.resize(size);
+        if (!input.read(payload.data(), size) || ComputeCrc32(payload) != crc) {
+            break;
+        }
+        handle_payload(std::string_view(payload));
+        valid_size += RECORD_HEADER_SIZE + size;
+    }
+    return valid_size;
+}
+
+[[noreturn]] void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& path, WriteAheadLogOptions options)
+    : path_(path)
+    , options_(options) {
+    fd_ = open(path_.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        ThrowSystemError("cannot open write-ahead log " + path_);
+    }
+    valid_size_ = ForEachRecord(path_, [](std::string_view) {});
+    const off_t file_size = lseek(fd_, 0, SEEK_END);
+    if (file_size < 0 || ftruncate(fd_, static_cast<off_t>(valid_size_)) < 0 || lseek(fd_, 0, SEEK_END) < 0) {
+        const int error = errno;
+        close(fd_);
+        errno = error;
+        ThrowSystemError("cannot prepare write-ahead log " + path_);
+    }
+    truncated_bytes_ = static_cast<size_t>(file_size) - valid_size_;
+    flusher_ = std::thread([this] { RunFlusher(); });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    flush_cv_.notify_one();
+    flusher_.join();
+    close(fd_);
+}
+
+WalReplayStats WriteAheadLog::Replay(SearchServer& search_server) const {
+    WalReplayStats stats;
+    // Подряд идущие удаления применяются одним пакетом RemoveDocuments
+    std::vector<int> pending_removals;
+    const auto apply_removals = [&search_server, &pending_removals, &stats] {
+        if (!pending_removals.empty()) {
+            search_server.RemoveDocuments(pending_removals);
+            stats.removed += pending_removals.size();
+            pending_removals.clear();
+        }
+    };
+
+    ForEachRecord(path_, [&](std::string_view payload) {
+        PayloadReader reader(payload);
+        const auto type = static_cast<RecordType>(reader.Read<uint8_t>());
+        const int document_id = reader.Read<int32_t>();
+        if (type == RecordType::REMOVE_DOCUMENT) {
+            pending_removals.push_back(document_id);
+            return;
+        }
+        if (type != RecordType::ADD_DOCUMENT) {
+            throw std::runtime_error("unknown write-ahead log record type");
+        }
+        apply_removals();
+        const auto status = static_cast<DocumentStatus>(reader.Read<uint8_t>());
+        std::vector<int> ratings(reader.Read<uint32_t>());
+        for (int& rating : ratings) {
+            rating = reader.Read<int32_t>();
+        }
+        const std::string_view document = reader.Take(reader.Read<uint32_t>());
+        search_server.AddDocument(document_id, document, status, ratings);
+        ++stats.added;
+        });
+    apply_removals();
+    return stats;
+}
+
+template <typename EncodePayload>
+uint64_t WriteAheadLog::Append(EncodePayload encode_payload) {
+    std::unique_lock lock(mutex_);
+    durable_cv_.wait(lock, [this] { return error_ || buffer_.size() < options_.max_buffered_bytes; });
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    const bool was_empty = buffer_.empty();
+    const size_t header_offset = buffer_.size();
+    buffer_.append(RECORD_HEADER_SIZE, '\0');
+    encode_payload(buffer_);
+    const std::string_view payload = std::string_view(buffer_).substr(header_offset + RECORD_HEADER_SIZE);
+    const uint32_t size = static_cast<uint32_t>(payload.size());
+    const uint32_t crc = ComputeCrc32(payload);
+    std::memcpy(buffer_.data() + header_offset, &size, sizeof(size));
+    std::memcpy(buffer_.data() + header_offset + sizeof(size), &crc, sizeof(crc));
+    const uint64_t sequence = ++appended_sequence_;
+    lock.unlock();
+    // Фоновый поток спит, пока буфер пуст, будить его нужно только первой записью
+    if (was_empty) {
+        flush_cv_.notify_one();
+    }
+    if (options_.durability == WalDurability::SYNC) {
+        WaitDurable(sequence);
+    }
+    return sequence;
+}
+
+uint64_t WriteAheadLog::AppendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    return Append([&](std::string& output) {
+        AppendValue(output, static_cast<uint8_t>(RecordType::ADD_DOCUMENT));
+        AppendValue(output, static_cast<int32_t>(document_id));
+        AppendValue(output, static_cast<uint8_t>(status));
+        AppendValue(output, static_cast<uint32_t>(ratings.size()));
+        for (const int rating : ratings) {
+            AppendValue(output, static_cast<int32_t>(rating));
+        }
+        AppendValue(output, static_cast<uint32_t>(document.size()));
+        output.append(document);
+        });
+}
+
+uint64_t WriteAheadLog::AppendRemoveDocument(int document_id) {
+    return Append([document_id](std::string& output) {
+        AppendValue(output, static_cast<uint8_t>(RecordType::REMOVE_DOCUMENT));
+        AppendValue(output, static_cast<int32_t>(document_id));
+        });
+}
+
+void WriteAheadLog::WaitDurable(uint64_t sequence) {
+    std::unique_lock lock(mutex_);
+    if (durable_sequence_ < sequence) {
+        sync_requested_ = true;
+        flush_cv_.notify_one();
+        durable_cv_.wait(lock, [this, sequence] { return error_ || durable_sequence_ >= sequence; });
+    }
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+void WriteAheadLog::Sync() {
+    uint64_t sequence;
+    {
+        std::lock_guard guard(mutex_);
+        sequence = appended_sequence_;
+    }
+    WaitDurable(sequence);
+}
+
+size_t WriteAheadLog::GetTruncatedBytes() const {
+    return truncated_bytes_;
+}
+
+// Групповая фиксация: пока идёт запись и fdatasync одной пачки, следующие записи копятся в buffer_
+// и уходят на диск следующим общим fdatasync
+void WriteAheadLog::RunFlusher() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        flush_cv_.wait(lock, [this] { return stopping_ || !buffer_.empty(); });
+        if (buffer_.empty()) {
+            return; // stopping_
+        }
+        flush_cv_.wait_for(lock, options_.group_commit_interval, [this] {
+            return stopping_ || sync_requested_ || buffer_.size() >= options_.max_buffered_bytes / 2;
+            });
+        std::string batch;
+        batch.swap(buffer_);
+        const uint64_t batch_sequence = appended_sequence_;
+        sync_requested_ = false;
+        lock.unlock();
+        // Освободившееся место в буфере нужно писателям, ожидающим в Append
+        durable_cv_.notify_all();
+
+        std::exception_ptr error;
+        try {
+            WriteToFile(batch);
+            if (options_.durability != WalDurability::BUFFERED && fdatasync(fd_) < 0) {
+                ThrowSystemError("cannot sync write-ahead log " + path_);
+            }
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (error) {
+            error_ = error;
+        }
+        else {
+            durable_sequence_ = batch_sequence;
+        }
+        durable_cv_.notify_all();
+        if (error_) {
+            return;
+        }
+    }
+}
+
+void WriteAheadLog::WriteToFile(const std::string& data) {
+    for (size_t written = 0; written < data.size();) {
+        const ssize_t size = write(fd_, data.data() + written, data.size() - written);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("cannot write write-ahead log " + path_);
+        }
+        written += static_cast<size_t>(size);
+    }
+}
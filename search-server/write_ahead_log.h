@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "document.h"
+
+class SearchServer;
+
+// Когда изменение считается сохранённым
+enum class WalDurability {
+    BUFFERED,     // Записи передаются ОС без fsync: переживают падение процесса, но не отключение питания
+    GROUP_COMMIT, // Накопленные за интервал записи сбрасываются одним fdatasync
+    SYNC,         // Изменение возвращает управление только после fdatasync, покрывающего его запись
+};
+
+struct WriteAheadLogOptions {
+    WalDurability durability = WalDurability::GROUP_COMMIT;
+    std::chrono::microseconds group_commit_interval{ 2000 };
+    size_t max_buffered_bytes = size_t{ 4 } << 20; // Выше этого объёма изменение ждёт сброса буфера
+};
+
+struct WalReplayStats {
+    size_t added = 0;
+    size_t removed = 0;
+};
+
+// Журнал изменений индекса: добавление документа (id, текст, статус, рейтинги) и удаление документа по id.
+// Запись кодируется в буфер памяти под мьютексом, запись в файл и fdatasync выполняет фоновый поток,
+// поэтому изменение индекса не ждёт диска, кроме режима SYNC. Каждая запись файла предваряется длиной
+// и CRC32, недописанная при сбое запись в конце файла отбрасывается при открытии.
+// Сервер пишет в журнал после успешного изменения: индекс живёт только в памяти,
+// поэтому это равносильно записи до изменения, а неудачные изменения в журнал не попадают
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const std::string& path, WriteAheadLogOptions options = WriteAheadLogOptions());
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Сбрасывает буфер на диск
+    ~WriteAheadLog();
+
+    // Применяет записи журнала к серверу. Журнал подключается к серверу после воспроизведения,
+    // иначе воспроизведённые изменения будут записаны повторно
+    WalReplayStats Replay(SearchServer& search_server) const;
+
+    // Возвращают порядковый номер записи
+    uint64_t AppendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    uint64_t AppendRemoveDocument(int document_id);
+
+    // Ждёт, пока запись с номером sequence будет сохранена согласно режиму durability
+    void WaitDurable(uint64_t sequence);
+
+    // Сохраняет все добавленные записи
+    void Sync();
+
+    // Байт недописанной записи, отрезанных от конца файла при открытии
+    size_t GetTruncatedBytes() const;
+
+private:
+    enum class RecordType : uint8_t {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2,
+    };
+
+    const std::string path_;
+    const WriteAheadLogOptions options_;
+    int fd_ = -1;
+    size_t valid_size_ = 0;
+    size_t truncated_bytes_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable flush_cv_;   // Фоновому потоку: появились записи или нужен немедленный сброс
+    std::condition_variable durable_cv_; // Ожидающим: буфер сброшен
+    std::string buffer_;
+    uint64_t appended_sequence_ = 0;
+    uint64_t durable_sequence_ = 0;
+    bool sync_requested_ = false;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+    std::thread flusher_;
+
+    // Кодирует запись в конец buffer_, вызывается под mutex_
+    template <typename EncodePayload>
+    uint64_t Append(EncodePayload encode_payload);
+
+    void RunFlusher();
+
+    void WriteToFile(const std::string& data);
+};
@@ -0,0 +1,101 @@
+#include "query_server.h"
+
+#include "read_input_functions.h"
+#include "search_server.h"
+
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace {
+
+struct ServerMainOptions {
+    string corpus_path;
+    string stop_words = "and in on the"s;
+    QueryServerOptions server;
+};
+
+QueryServer* running_server = nullptr;
+
+// Stop только пишет в eventfd и атомарную переменную, что допустимо в обработчике сигнала
+extern "C" void HandleStopSignal(int) {
+    if (running_server != nullptr) {
+        running_server->Stop();
+    }
+}
+
+ServerMainOptions ParseOptions(int argc, char* argv[]) {
+    ServerMainOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string_view argument = argv[i];
+        const size_t equals = argument.find('=');
+        const string_view key = argument.substr(0, equals);
+        const string value = equals == argument.npos ? ""s : string(argument.substr(equals + 1));
+        if (key == "--corpus"sv) {
+            options.corpus_path = value;
+        }
+        else if (key == "--stop-words"sv) {
+            options.stop_words = value;
+        }
+        else if (key == "--address"sv) {
+            options.server.address = value;
+        }
+        else if (key == "--port"sv) {
+            options.server.port = static_cast<uint16_t>(stoul(value));
+        }
+        else if (key == "--workers"sv) {
+            options.server.admission.worker_count = stoull(value);
+        }
+        else if (key == "--max-queue"sv) {
+            options.server.admission.max_queue_depth = stoull(value);
+        }
+        else if (key == "--max-wait-ms"sv) {
+            options.server.admission.max_estimated_wait = chrono::milliseconds(stoll(value));
+        }
+        else if (key == "--pipeline-depth"sv) {
+            options.server.max_pipeline_depth = stoull(value);
+        }
+        else {
+            throw invalid_argument("unknown option "s + string(argument));
+        }
+    }
+    if (options.corpus_path.empty()) {
+        throw invalid_argument("--corpus is required"s);
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const ServerMainOptions options = ParseOptions(argc, argv);
+        SearchServer search_server(options.stop_words);
+        ifstream corpus(options.corpus_path);
+        if (!corpus) {
+            throw invalid_argument("cannot open "s + options.corpus_path);
+        }
+        const int document_count = ReadDocuments(corpus, search_server);
+        cerr << "Indexed "s << document_count << " documents"s << endl;
+
+        QueryServer server(search_server, options.server);
+        running_server = &server;
+        signal(SIGPIPE, SIG_IGN);
+        signal(SIGINT, HandleStopSignal);
+        signal(SIGTERM, HandleStopSignal);
+        cerr << "Listening on "s << options.server.address << ':' << server.GetPort() << endl;
+        server.Run();
+        running_server = nullptr;
+    }
+    catch (const exception& e) {
+        cerr << "Error: "s << e.what() << endl;
+        cerr << "Usage: search_server_daemon --corpus=documents.tsv [--address=127.0.0.1] [--port=7700] [--workers=N] [--max-queue=1024] [--max-wait-ms=100] [--pipeline-depth=256] [--stop-words=\"and in on the\"]"s << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,429 @@
+#include "query_server.h"
+
+#include "read_input_functions.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t READ_BUFFER_SIZE = 64 * 1024;
+constexpr int MAX_EVENTS = 256;
+// Идентификаторы событий epoll для служебных дескрипторов, соединения нумеруются с нуля
+constexpr uint64_t LISTEN_EVENT_ID = UINT64_MAX;
+constexpr uint64_t WAKE_EVENT_ID = UINT64_MAX - 1;
+
+[[noreturn]] void ThrowSystemError(const char* what) {
+    throw system_error(errno, generic_category(), what);
+}
+
+string_view CutField(string_view& text) {
+    const size_t tab = text.find('\t');
+    const string_view field = text.substr(0, tab);
+    text.remove_prefix(tab == text.npos ? text.size() : tab + 1);
+    return field;
+}
+
+} // namespace
+
+QueryServer::QueryServer(const SearchServer& search_server, QueryServerOptions options)
+    : search_server_(search_server)
+    , options_(move(options)) {
+    if (options_.max_pipeline_depth == 0) {
+        throw invalid_argument("invalid query server options");
+    }
+    try {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            ThrowSystemError("socket");
+        }
+        const int enable = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options_.port);
+        if (inet_pton(AF_INET, options_.address.c_str(), &address.sin_addr) != 1) {
+            throw invalid_argument("invalid address "s + options_.address);
+        }
+        if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+            ThrowSystemError("bind");
+        }
+        if (listen(listen_fd_, SOMAXCONN) < 0) {
+            ThrowSystemError("listen");
+        }
+
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epoll_fd_ < 0 || wake_fd_ < 0) {
+            ThrowSystemError("epoll");
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = LISTEN_EVENT_ID;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+        event.data.u64 = WAKE_EVENT_ID;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+    }
+    catch (...) {
+        for (const int fd : { listen_fd_, epoll_fd_, wake_fd_ }) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        throw;
+    }
+
+    executor_ = make_unique<AsyncSearchExecutor>(search_server_, options_.admission);
+}
+
+QueryServer::~QueryServer() {
+    executor_.reset();
+    for (auto& [id, connection] : connections_) {
+        close(connection.fd);
+    }
+    close(listen_fd_);
+    close(epoll_fd_);
+    close(wake_fd_);
+}
+
+uint16_t QueryServer::GetPort() const {
+    sockaddr_in address{};
+    socklen_t length = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length);
+    return ntohs(address.sin_port);
+}
+
+void QueryServer::Run() {
+    epoll_event events[MAX_EVENTS];
+    while (!stopping_.load()) {
+        const int event_count = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait");
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == LISTEN_EVENT_ID) {
+                AcceptConnections();
+                continue;
+            }
+            if (id == WAKE_EVENT_ID) {
+                uint64_t value;
+                while (read(wake_fd_, &value, sizeof(value)) > 0) {
+                }
+                ProcessCompletions();
+                continue;
+            }
+            // Соединение могло быть закрыто при обработке предыдущего события той же пачки
+            const auto it = connections_.find(id);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = it->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN)) {
+                CloseConnection(id);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                ReadRequests(id, connection);
+            }
+            if (connections_.count(id) > 0 && FlushResponses(id, connection)) {
+                UpdateEvents(id, connection);
+            }
+        }
+    }
+}
+
+void QueryServer::Stop() {
+    stopping_.store(true);
+    Wake();
+}
+
+void QueryServer::Wake() {
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t written = write(wake_fd_, &value, sizeof(value));
+}
+
+AsyncQuery QueryServer::ParseRequest(string_view request) {
+    AsyncQuery query;
+    query.raw_query = string(CutField(request));
+    const string_view status_name = CutField(request);
+    const string_view k_text = CutField(request);
+    const string_view priority_name = CutField(request);
+    if (!status_name.empty()) {
+        query.filter = DocumentFilter(ParseDocumentStatus(status_name));
+    }
+    if (!k_text.empty()) {
+        size_t k = 0;
+        const auto [end, error] = from_chars(k_text.data(), k_text.data() + k_text.size(), k);
+        if (error != errc() || end != k_text.data() + k_text.size() || k == 0) {
+            throw invalid_argument("invalid K");
+        }
+        query.max_results = min(k, static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    }
+    if (priority_name == "HIGH"sv) {
+        query.priority = QueryPriority::HIGH;
+    }
+    else if (priority_name == "LOW"sv) {
+        query.priority = QueryPriority::LOW;
+    }
+    else if (!priority_name.empty() && priority_name != "NORMAL"sv) {
+        throw invalid_argument("unknown priority "s + string(priority_name));
+    }
+    return query;
+}
+
+string QueryServer::FormatResponse(const vector<Document>& documents, exception_ptr error) {
+    if (error) {
+        try {
+            rethrow_exception(error);
+        }
+        catch (const exception& e) {
+            string message = e.what();
+            replace(message.begin(), message.end(), '\n', ' ');
+            return "ERR "s + message + '\n';
+        }
+        catch (...) {
+            return "ERR internal error\n"s;
+        }
+    }
+    string response = "OK "s + to_string(documents.size()) + '\n';
+    char buffer[64];
+    for (const Document& document : documents) {
+        char* position = to_chars(buffer, buffer + sizeof(buffer), document.id).ptr;
+        *position++ = ' ';
+        position = to_chars(position, buffer + sizeof(buffer), document.relevance).ptr;
+        *position++ = ' ';
+        position = to_chars(position, buffer + sizeof(buffer), document.rating).ptr;
+        *position++ = '\n';
+        response.append(buffer, static_cast<size_t>(position - buffer));
+    }
+    return response;
+}
+
+void QueryServer::SubmitRequest(uint64_t connection_id, Connection& connection, string_view request) {
+    const uint64_t sequence = connection.next_sequence++;
+    AsyncQuery query;
+    try {
+        query = ParseRequest(request);
+    }
+    catch (const exception& e) {
+        connection.ready.emplace(sequence, "ERR "s + e.what() + '\n');
+        return;
+    }
+    const bool accepted = executor_->TrySubmit(move(query), [this, connection_id, sequence](vector<Document> documents, exception_ptr error) {
+        Complete(connection_id, sequence, FormatResponse(documents, error));
+        });
+    if (accepted) {
+        ++connection.in_flight;
+    }
+    else {
+        connection.ready.emplace(sequence, "ERR overloaded\n"s);
+    }
+}
+
+void QueryServer::Complete(uint64_t connection_id, uint64_t sequence, string response) {
+    bool was_empty;
+    {
+        lock_guard guard(completions_mutex_);
+        was_empty = completions_.empty();
+        completions_.push_back({ connection_id, sequence, move(response) });
+    }
+    // Цикл событий забирает все готовые ответы разом, поэтому будить его нужно только для первого
+    if (was_empty) {
+        Wake();
+    }
+}
+
+void QueryServer::AcceptConnections() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return; // EAGAIN либо нехватка дескрипторов: попробуем при следующем событии
+        }
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        const uint64_t id = next_connection_id_++;
+        Connection& connection = connections_[id];
+        connection.fd = fd;
+        connection.events = EPOLLIN;
+        epoll_event event{};
+        event.events = connection.events;
+        event.data.u64 = id;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            CloseConnection(id);
+        }
+    }
+}
+
+void QueryServer::ReadRequests(uint64_t connection_id, Connection& connection) {
+    char buffer[READ_BUFFER_SIZE];
+    SubmitBufferedRequests(connection_id, connection);
+    while (!connection.read_closed && connection.in_flight < options_.max_pipeline_depth) {
+        const ssize_t size = read(connection.fd, buffer, sizeof(buffer));
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                connection.read_closed = true;
+            }
+            break;
+        }
+        if (size == 0) {
+            connection.read_closed = true;
+            break;
+        }
+        connection.input.append(buffer, static_cast<size_t>(size));
+        SubmitBufferedRequests(connection_id, connection);
+        if (connection.input.size() > options_.max_line_length && !HasBufferedRequest(connection)) {
+            // Строку без конца не разобрать: отвечаем ошибкой и больше ничего не читаем
+            connection.ready.emplace(connection.next_sequence++, "ERR request is too long\n"s);
+            connection.input.clear();
+            connection.read_closed = true;
+        }
+    }
+}
+
+void QueryServer::SubmitBufferedRequests(uint64_t connection_id, Connection& connection) {
+    size_t line_begin = 0;
+    for (size_t line_end; connection.in_flight < options_.max_pipeline_depth
+        && (line_end = connection.input.find('\n', line_begin)) != string::npos; line_begin = line_end + 1) {
+        size_t length = line_end - line_begin;
+        if (length > 0 && connection.input[line_end - 1] == '\r') {
+            --length;
+        }
+        SubmitRequest(connection_id, connection, string_view(connection.input).substr(line_begin, length));
+    }
+    connection.input.erase(0, line_begin);
+}
+
+bool QueryServer::HasBufferedRequest(const Connection& connection) {
+    return connection.input.find('\n') != string::npos;
+}
+
+void QueryServer::ProcessCompletions() {
+    vector<Completion> completions;
+    {
+        lock_guard guard(completions_mutex_);
+        completions.swap(completions_);
+    }
+    vector<uint64_t> touched;
+    for (Completion& completion : completions) {
+        const auto it = connections_.find(completion.connection_id);
+        if (it == connections_.end()) {
+            continue; // Клиент отключился, не дождавшись ответа
+        }
+        --it->second.in_flight;
+        it->second.ready.emplace(completion.sequence, move(completion.response));
+        touched.push_back(completion.connection_id);
+    }
+    sort(touched.begin(), touched.end());
+    touched.erase(unique(touched.begin(), touched.end()), touched.end());
+    for (const uint64_t id : touched) {
+        Connection& connection = connections_.at(id);
+        if (FlushResponses(id, connection)) {
+            // Освободилось место в конвейере: отправляем отложенные из-за его глубины запросы и дочитываем новые
+            ReadRequests(id, connection);
+            if (FlushResponses(id, connection)) {
+                UpdateEvents(id, connection);
+            }
+        }
+    }
+}
+
+bool QueryServer::FlushResponses(uint64_t connection_id, Connection& connection) {
+    // Ответы уходят строго в порядке запросов: берём только непрерывный префикс готовых
+    for (auto it = connection.ready.begin(); it != connection.ready.end() && it->first == connection.next_response;
+         it = connection.ready.erase(it)) {
+        connection.output.push_back(move(it->second));
+        ++connection.next_response;
+    }
+
+    while (!connection.output.empty()) {
+        iovec buffers[IOV_MAX];
+        int buffer_count = 0;
+        for (auto it = connection.output.begin(); it != connection.output.end() && buffer_count < IOV_MAX; ++it, ++buffer_count) {
+            const size_t offset = buffer_count == 0 ? connection.output_offset : 0;
+            buffers[buffer_count].iov_base = it->data() + offset;
+            buffers[buffer_count].iov_len = it->size() - offset;
+        }
+        ssize_t written = writev(connection.fd, buffers, buffer_count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return true; // Допишем по EPOLLOUT
+            }
+            CloseConnection(connection_id);
+            return false;
+        }
+        while (written > 0) {
+            const size_t remaining = connection.output.front().size() - connection.output_offset;
+            if (static_cast<size_t>(written) < remaining) {
+                connection.output_offset += static_cast<size_t>(written);
+                break;
+            }
+            written -= static_cast<ssize_t>(remaining);
+            connection.output.pop_front();
+            connection.output_offset = 0;
+        }
+    }
+
+    if (connection.read_closed && connection.in_flight == 0 && connection.ready.empty() && !HasBufferedRequest(connection)) {
+        CloseConnection(connection_id);
+        return false;
+    }
+    return true;
+}
+
+void QueryServer::UpdateEvents(uint64_t connection_id, Connection& connection) {
+    uint32_t events = 0;
+    if (!connection.read_closed && connection.in_flight < options_.max_pipeline_depth) {
+        events |= EPOLLIN;
+    }
+    if (!connection.output.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events == connection.events) {
+        return;
+    }
+    connection.events = events;
+    epoll_event event{};
+    event.events = events;
+    event.data.u64 = connection_id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void QueryServer::CloseConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    // Запросы соединения в очереди исполнителя остаются: их ответы будут отброшены в ProcessCompletions
+    close(it->second.fd);
+    connections_.erase(it);
+}
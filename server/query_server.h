@@ -0,0 +1,116 @@
+#pragma once
+
+#include "async_search.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Параметры сетевого сервера запросов
+struct QueryServerOptions {
+    std::string address = "127.0.0.1";
+    uint16_t port = 7700;               // 0 - любой свободный порт
+    AdmissionOptions admission;         // Пул обработчиков и порог отказа при перегрузке
+    size_t max_pipeline_depth = 256;    // Запросов соединения в обработке, после которых чтение приостанавливается
+    size_t max_line_length = 64 * 1024;
+};
+
+// Сервер запросов поверх TCP со строчным протоколом. Запрос - строка "запрос[<TAB>STATUS[<TAB>K[<TAB>PRIORITY]]]",
+// ответ - строка "OK <n>" и n строк "id relevance rating" либо строка "ERR <сообщение>".
+// Клиент может отправлять запросы, не дожидаясь ответов: ответы приходят в порядке запросов.
+// Один поток ведёт неблокирующий цикл событий epoll, поиск выполняет AsyncSearchExecutor,
+// готовые ответы соединения отправляются одним вызовом writev. Запрос, отклонённый при перегрузке,
+// сразу получает ответ "ERR overloaded".
+class QueryServer {
+public:
+    QueryServer(const SearchServer& search_server, QueryServerOptions options);
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    ~QueryServer();
+
+    // Фактический порт после привязки сокета
+    uint16_t GetPort() const;
+
+    // Обслуживает соединения до вызова Stop
+    void Run();
+
+    // Может вызываться из любого потока
+    void Stop();
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        uint64_t next_sequence = 0;            // Номер следующего прочитанного запроса
+        uint64_t next_response = 0;            // Номер ответа, который должен уйти следующим
+        std::map<uint64_t, std::string> ready; // Готовые ответы, опередившие предыдущие
+        std::deque<std::string> output;
+        size_t output_offset = 0;              // Отправленная часть output.front()
+        size_t in_flight = 0;
+        bool read_closed = false;
+        uint32_t events = 0;
+    };
+
+    struct Completion {
+        uint64_t connection_id;
+        uint64_t sequence;
+        std::string response;
+    };
+
+    const SearchServer& search_server_;
+    const QueryServerOptions options_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1; // eventfd: обработчики сообщают о готовых ответах, Stop - об остановке
+    std::atomic<bool> stopping_{ false };
+
+    std::unordered_map<uint64_t, Connection> connections_; // Принадлежит потоку цикла событий
+    uint64_t next_connection_id_ = 0;
+
+    std::mutex completions_mutex_;
+    std::vector<Completion> completions_;
+
+    // Создаётся последним и останавливается первым: обработчики пишут в completions_ и wake_fd_
+    std::unique_ptr<AsyncSearchExecutor> executor_;
+
+    static AsyncQuery ParseRequest(std::string_view request);
+
+    static std::string FormatResponse(const std::vector<Document>& documents, std::exception_ptr error);
+
+    void SubmitRequest(uint64_t connection_id, Connection& connection, std::string_view request);
+
+    void Complete(uint64_t connection_id, uint64_t sequence, std::string response);
+
+    void Wake();
+
+    void AcceptConnections();
+
+    void ReadRequests(uint64_t connection_id, Connection& connection);
+
+    // Отправляет исполнителю полные строки из input, пока в обработке меньше max_pipeline_depth запросов.
+    // Остальные строки ждут в input, пока не придут ответы
+    void SubmitBufferedRequests(uint64_t connection_id, Connection& connection);
+
+    static bool HasBufferedRequest(const Connection& connection);
+
+    void ProcessCompletions();
+
+    // Отправляет готовые ответы, возвращает false, если соединение закрыто
+    bool FlushResponses(uint64_t connection_id, Connection& connection);
+
+    void UpdateEvents(uint64_t connection_id, Connection& connection);
+
+    void CloseConnection(uint64_t connection_id);
+};
@@ -0,0 +1,81 @@
+#include "query_server.h"
+
+#include "test_example_functions.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// Отправляет запросы одним вызовом write, закрывает передачу и читает ответы до закрытия соединения сервером
+string Exchange(uint16_t port, const string& requests) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT(fd >= 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    ASSERT(connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+    ASSERT(write(fd, requests.data(), requests.size()) == static_cast<ssize_t>(requests.size()));
+    shutdown(fd, SHUT_WR);
+
+    string responses;
+    char buffer[4096];
+    for (ssize_t size; (size = read(fd, buffer, sizeof(buffer))) > 0;) {
+        responses.append(buffer, static_cast<size_t>(size));
+    }
+    close(fd);
+    return responses;
+}
+
+void TestPipelineDepthLimit() {
+    SearchServer search_server("and with"s);
+    for (int id = 0; id < 100; ++id) {
+        search_server.AddDocument(id, "funny pet and nasty rat number"s + to_string(id), DocumentStatus::ACTUAL, { id });
+    }
+
+    // Очередь исполнителя вмещает столько же запросов, сколько конвейер соединения. Если бы сервер
+    // отправил исполнителю все запросы из одного чтения, часть из них получила бы ERR overloaded
+    QueryServerOptions options;
+    options.port = 0;
+    options.max_pipeline_depth = 4;
+    options.admission.worker_count = 1;
+    options.admission.max_queue_depth = options.max_pipeline_depth;
+    options.admission.max_estimated_wait = 0ms;
+    QueryServer server(search_server, options);
+    thread server_thread([&server] { server.Run(); });
+
+    const int request_count = 500;
+    string requests;
+    for (int i = 0; i < request_count; ++i) {
+        requests += "rat number"s + to_string(i % 100) + "\tACTUAL\t1\n"s;
+    }
+    const string responses = Exchange(server.GetPort(), requests);
+    server.Stop();
+    server_thread.join();
+
+    istringstream input(responses);
+    int response_count = 0;
+    for (string line; getline(input, line);) {
+        ASSERT_HINT(line == "OK 1"s, line);
+        ASSERT(getline(input, line));
+        ASSERT_HINT(line.rfind(to_string(response_count % 100) + " "s, 0) == 0, line);
+        ++response_count;
+    }
+    ASSERT(response_count == request_count);
+}
+
+} // namespace
+
+int main() {
+    TestPipelineDepthLimit();
+    cerr << "TestPipelineDepthLimit OK"s << endl;
+}